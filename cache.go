@@ -0,0 +1,210 @@
+package taglib
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"path/filepath"
+	"strings"
+)
+
+// CacheOptions configures a [CachedReader]. Zero fields take the defaults of [CacheHint] for an unknown format.
+type CacheOptions struct {
+	// BlockSize is the unit that ranges are fetched and cached in.
+	BlockSize int
+	// Head and Tail are the number of bytes at the start and end of the file fetched on the first read, where
+	// most formats keep their tags. Ranges that touch or overlap are fetched in one request.
+	Head, Tail int64
+}
+
+// CacheStats counts what a [CachedReader] has done so far. Hits and Misses are in blocks.
+type CacheStats struct {
+	Hits, Misses int
+	Requests     int   // calls to the underlying ReadAt
+	Bytes        int64 // bytes fetched by those calls
+}
+
+const (
+	defaultBlockSize = 32 * 1024
+	defaultHead      = 64 * 1024
+	defaultTail      = 64 * 1024
+)
+
+// CacheHint returns the [CacheOptions] for the format of the file at path, by its extension.
+// The head and tail regions are sized to cover where TagLib looks for tags and stream properties.
+func CacheHint(path string) CacheOptions {
+	switch strings.ToLower(filepath.Ext(path)) {
+	case ".mp3", ".mp2":
+		// ID3v2 and the first frame up front, ID3v1 and APE at the end
+		return CacheOptions{Head: 64 * 1024, Tail: 16 * 1024}
+	case ".flac":
+		// Metadata blocks, often with a picture, up front. Only a stray ID3v1 at the end
+		return CacheOptions{Head: 256 * 1024, Tail: 4 * 1024}
+	case ".m4a", ".m4b", ".m4p", ".m4r", ".mp4", ".3g2", ".aac":
+		// moov is at either end, depending on how the file was muxed
+		return CacheOptions{Head: 64 * 1024, Tail: 64 * 1024}
+	case ".ogg", ".oga", ".opus", ".spx":
+		// Header pages up front, the last page for the length
+		return CacheOptions{Head: 64 * 1024, Tail: 64 * 1024}
+	case ".wav", ".aif", ".aiff", ".aifc":
+		// Format chunk up front, LIST and ID3 chunks usually after the audio
+		return CacheOptions{Head: 16 * 1024, Tail: 64 * 1024}
+	}
+	return CacheOptions{}
+}
+
+// CachedReader reads from an [io.ReaderAt] in cached blocks, so that the many small reads and seeks TagLib makes
+// turn into a few range requests. It is meant for sources where each ReadAt is a round trip, like an object store,
+// and is passed to [ReadTagsFrom]. Fetched blocks are kept for the life of the reader.
+// It isn't safe for concurrent use.
+type CachedReader struct {
+	r     io.ReaderAt
+	size  int64
+	opts  CacheOptions
+	pos   int64
+	init  bool
+	err   error
+	stats CacheStats
+
+	blocks map[int64][]byte
+}
+
+// NewCachedReader returns a [CachedReader] over the size bytes of r. See [CacheHint] for opts.
+func NewCachedReader(r io.ReaderAt, size int64, opts CacheOptions) *CachedReader {
+	if opts.BlockSize <= 0 {
+		opts.BlockSize = defaultBlockSize
+	}
+	if opts.Head <= 0 {
+		opts.Head = defaultHead
+	}
+	if opts.Tail <= 0 {
+		opts.Tail = defaultTail
+	}
+	return &CachedReader{r: r, size: size, opts: opts, blocks: map[int64][]byte{}}
+}
+
+// Stats returns the counters so far.
+func (c *CachedReader) Stats() CacheStats {
+	return c.stats
+}
+
+// Read implements [io.Reader].
+func (c *CachedReader) Read(p []byte) (int, error) {
+	n, err := c.ReadAt(p, c.pos)
+	c.pos += int64(n)
+	if n > 0 && errors.Is(err, io.EOF) {
+		err = nil
+	}
+	return n, err
+}
+
+// Seek implements [io.Seeker].
+func (c *CachedReader) Seek(offset int64, whence int) (int64, error) {
+	switch whence {
+	case io.SeekStart:
+	case io.SeekCurrent:
+		offset += c.pos
+	case io.SeekEnd:
+		offset += c.size
+	default:
+		return 0, fmt.Errorf("invalid whence %d", whence)
+	}
+	if offset < 0 {
+		return 0, fmt.Errorf("negative position %d", offset)
+	}
+	c.pos = offset
+	return offset, nil
+}
+
+// ReadAt implements [io.ReaderAt].
+func (c *CachedReader) ReadAt(p []byte, off int64) (int, error) {
+	if off < 0 {
+		return 0, fmt.Errorf("negative offset %d", off)
+	}
+	if off >= c.size {
+		return 0, io.EOF
+	}
+	if len(p) == 0 {
+		return 0, nil
+	}
+	end := min(off+int64(len(p)), c.size)
+	if !c.init {
+		c.init = true
+		c.prefetch()
+	}
+	if err := c.fetch(off, end, true); err != nil {
+		return 0, err
+	}
+
+	n := 0
+	for pos := off; pos < end; {
+		bs := int64(c.opts.BlockSize)
+		block := c.blocks[pos/bs]
+		n += copy(p[n:end-off], block[pos%bs:])
+		pos = off + int64(n)
+	}
+	if n < len(p) {
+		return n, io.EOF
+	}
+	return n, nil
+}
+
+// prefetch fetches the head and tail of the file, in one request if they meet
+func (c *CachedReader) prefetch() {
+	bs := int64(c.opts.BlockSize)
+	headEnd := min(c.opts.Head, c.size)
+	tailStart := max(c.size-c.opts.Tail, 0) / bs * bs
+	if tailStart <= headEnd {
+		c.err = c.fetch(0, c.size, false)
+		return
+	}
+	if c.err = c.fetch(0, headEnd, false); c.err == nil {
+		c.err = c.fetch(tailStart, c.size, false)
+	}
+}
+
+// fetch makes sure the blocks covering [off, end) are cached, fetching each run of missing blocks in one request
+func (c *CachedReader) fetch(off, end int64, count bool) error {
+	if c.err != nil {
+		return c.err
+	}
+	bs := int64(c.opts.BlockSize)
+	first, last := off/bs, (end-1)/bs
+	for i := first; i <= last; {
+		if _, ok := c.blocks[i]; ok {
+			if count {
+				c.stats.Hits++
+			}
+			i++
+			continue
+		}
+		j := i
+		for j+1 <= last {
+			if _, ok := c.blocks[j+1]; ok {
+				break
+			}
+			j++
+		}
+
+		start, stop := i*bs, min((j+1)*bs, c.size)
+		buf := make([]byte, stop-start)
+		n, err := c.r.ReadAt(buf, start)
+		c.stats.Requests++
+		c.stats.Bytes += int64(n)
+		if n < len(buf) {
+			if err == nil || errors.Is(err, io.EOF) {
+				err = io.ErrUnexpectedEOF
+			}
+			c.err = err
+			return err
+		}
+		for k := i; k <= j; k++ {
+			c.blocks[k] = buf[(k-i)*bs : min((k-i+1)*bs, int64(len(buf)))]
+		}
+		if count {
+			c.stats.Misses += int(j - i + 1)
+		}
+		i = j + 1
+	}
+	return nil
+}
@@ -0,0 +1,121 @@
+package taglib
+
+import (
+	"bytes"
+	"fmt"
+	"path/filepath"
+)
+
+// ReadImageHashed reads the image that [ReadImageRaw] reads from path, along with the hash of its data, which is
+// the same as [ImageInfo.Hash]. The hash is computed inside the WASM instance first, and if known reports it, the
+// data isn't copied out and nil is returned in its place. If there are no images in the file it returns 0 and nil.
+func ReadImageHashed(path string, known func(hash uint64) bool) (uint64, []byte, error) {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return 0, nil, fmt.Errorf("make path abs %w", err)
+	}
+	format, err := DetectFormat(path)
+	if err != nil {
+		return 0, nil, err
+	}
+
+	mod, err := newModuleRO(path)
+	if err != nil {
+		return 0, nil, fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	img, hash, err := mod.fileImageHash(wasmPath(path), newHint(format, 0))
+	if err != nil {
+		return 0, nil, fmt.Errorf("call: %w", err)
+	}
+	if img == nil || (known != nil && known(hash)) {
+		return hash, nil, nil
+	}
+	return hash, bytes.Clone(img), nil
+}
+
+// CoverStore keeps images by the hash that [ReadImageHashed] returns, for [ExtractCovers].
+type CoverStore interface {
+	// Has reports whether the store already has the image with hash
+	Has(hash uint64) bool
+	// Put adds the image with hash. img is only valid during the call, so it must be copied to be kept
+	Put(hash uint64, img []byte) error
+}
+
+// CoverResult is the image of a file read by [ExtractCovers]. Hash and Size are 0 if the file has no images.
+type CoverResult struct {
+	Hash uint64
+	Size int
+	// Stored is true if this file's image was put in the store, which happens for only one of the files that
+	// share an image, and for none of them if the store already had it
+	Stored bool
+	Err    error
+}
+
+// ExtractCovers reads the image that [ReadImageRaw] reads from each path and puts it in store, so that each distinct
+// image is put exactly once however many files share it. Images are hashed inside the WASM instance, and the data
+// of those the store already has, or that an earlier path had, is never copied out. The files share WASM instances
+// like [ReadTagsBatch], and the results are in the same order as paths. A file that can't be read, or whose image
+// the store can't take, has [CoverResult.Err] set instead of failing the whole call.
+func ExtractCovers(paths []string, store CoverStore) ([]CoverResult, error) {
+	results := make([]CoverResult, len(paths))
+	seen := map[uint64]bool{}
+
+	var mod *module
+	var modRoot string
+	defer func() {
+		if mod != nil {
+			mod.close()
+		}
+	}()
+
+	for i, path := range paths {
+		path, err := filepath.Abs(path)
+		if err != nil {
+			results[i].Err = fmt.Errorf("make path abs %w", err)
+			continue
+		}
+		format, err := DetectFormat(path)
+		if err != nil {
+			results[i].Err = err
+			continue
+		}
+
+		if root := mountRoot(path); mod == nil || root != modRoot || mod.worn() {
+			if mod != nil {
+				mod.close()
+			}
+			if mod, err = newModuleRO(path); err != nil {
+				mod = nil
+				return nil, fmt.Errorf("init module: %w", err)
+			}
+			modRoot = root
+		}
+
+		img, hash, err := mod.fileImageHash(wasmPath(path), newHint(format, 0))
+		if err != nil {
+			results[i].Err = fmt.Errorf("call: %w", err)
+			mod.close() // it trapped, so start again with a fresh one
+			mod = nil
+			continue
+		}
+		if img == nil {
+			continue
+		}
+
+		results[i].Hash, results[i].Size = hash, len(img)
+		if seen[hash] || store.Has(hash) {
+			seen[hash] = true
+			continue
+		}
+		if err := store.Put(hash, img); err != nil {
+			results[i].Err = fmt.Errorf("store: %w", err)
+			continue
+		}
+		seen[hash] = true
+		results[i].Stored = true
+	}
+	return results, nil
+}
@@ -0,0 +1,366 @@
+package taglib
+
+import (
+	"bytes"
+	"fmt"
+	"io"
+	"os"
+	"unicode/utf8"
+)
+
+// Format is an audio file format that TagLib can read, as recognized by [DetectFormat].
+type Format uint8
+
+const (
+	// FormatUnknown is a file that wasn't recognized by its contents, but may still be one TagLib can read
+	FormatUnknown Format = iota
+	FormatMPEG
+	FormatFLAC
+	FormatMP4
+	FormatOggVorbis
+	FormatOggOpus
+	FormatOggSpeex
+	FormatOggFLAC
+	FormatWAV
+	FormatAIFF
+	FormatAPE
+	FormatWavPack
+	FormatMPC
+	FormatTrueAudio
+	FormatASF
+	FormatDSF
+	FormatDSDIFF
+	FormatShorten
+	FormatMod
+	FormatS3M
+	FormatIT
+	FormatXM
+)
+
+var formatNames = [...]string{
+	FormatUnknown:   "unknown",
+	FormatMPEG:      "MPEG",
+	FormatFLAC:      "FLAC",
+	FormatMP4:       "MP4",
+	FormatOggVorbis: "Ogg Vorbis",
+	FormatOggOpus:   "Ogg Opus",
+	FormatOggSpeex:  "Ogg Speex",
+	FormatOggFLAC:   "Ogg FLAC",
+	FormatWAV:       "WAV",
+	FormatAIFF:      "AIFF",
+	FormatAPE:       "APE",
+	FormatWavPack:   "WavPack",
+	FormatMPC:       "Musepack",
+	FormatTrueAudio: "TrueAudio",
+	FormatASF:       "ASF",
+	FormatDSF:       "DSF",
+	FormatDSDIFF:    "DSDIFF",
+	FormatShorten:   "Shorten",
+	FormatMod:       "Mod",
+	FormatS3M:       "S3M",
+	FormatIT:        "IT",
+	FormatXM:        "XM",
+}
+
+func (f Format) String() string {
+	if int(f) < len(formatNames) {
+		return formatNames[f]
+	}
+	return fmt.Sprintf("Format(%d)", f)
+}
+
+// MPEGTag is a type of tag in an MPEG file. Tag types can be combined with the bitwise OR operator.
+type MPEGTag uint8
+
+const (
+	MPEGTagID3v1 MPEGTag = 1 << iota
+	MPEGTagID3v2
+	MPEGTagAPE
+)
+
+// ReadOptions tunes a read: what is already known about a file, for example from a database, so the read can skip
+// work, and limits on what it copies out.
+type ReadOptions struct {
+	// Format is the format of the file. The guest then opens it as that format directly, instead of trying each
+	// one TagLib supports. It's detected with [DetectFormat] if unknown. A wrong format falls back to detection
+	// only if TagLib can't open the file as that format at all, so it should come from a reliable source
+	Format Format
+	// MPEGTags limits the tag types read from an MPEG file, for example to ignore a stale ID3v1 tag.
+	// Zero reads all of them
+	MPEGTags MPEGTag
+	// MaxValueBytes cuts tag values longer than it to a prefix of at most that many bytes, so that values that
+	// are rarely shown, like lyrics, aren't copied out in full. Zero means no limit. Only [ReadTagsTruncated] uses
+	// it, since it reports which values were cut
+	MaxValueBytes int
+}
+
+// hint passes what is known about a file to the guest, see taglib.cpp
+type hint uint32
+
+func newHint(format Format, tags MPEGTag) hint {
+	return hint(format) | hint(tags)<<8
+}
+
+// DetectFormat recognizes the format of the file at path from its first few kilobytes, without involving TagLib.
+// It returns [ErrInvalidFile] only if the file is clearly not audio: empty, plain text, or an image, document or
+// archive with a known signature. Anything else that isn't recognized is [FormatUnknown], and left to TagLib,
+// which knows formats without a signature too, like older Musepack or 15 sample Mod files.
+func DetectFormat(path string) (Format, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return FormatUnknown, fmt.Errorf("%w: %w", ErrInvalidFile, err)
+	}
+	defer f.Close()
+
+	info, err := f.Stat()
+	if err != nil {
+		return FormatUnknown, fmt.Errorf("%w: %w", ErrInvalidFile, err)
+	}
+	format, ok := sniff(f, info.Size())
+	if !ok {
+		return FormatUnknown, ErrInvalidFile
+	}
+	return format, nil
+}
+
+// detectFormatBytes is [DetectFormat] for the contents of a file
+func detectFormatBytes(b []byte) (Format, error) {
+	format, ok := sniff(bytes.NewReader(b), int64(len(b)))
+	if !ok {
+		return FormatUnknown, ErrInvalidFile
+	}
+	return format, nil
+}
+
+// sniffSize is how much of the head of a file is looked at. It covers the Mod signature at 1080
+const sniffSize = 4096
+
+// sniff recognizes the format of r. It returns false only if r is clearly not a file TagLib can read
+func sniff(r io.ReaderAt, size int64) (Format, bool) {
+	var buf [sniffSize]byte
+	head := readAtMost(r, buf[:], 0)
+	if size == 0 || len(head) == 0 {
+		return FormatUnknown, false
+	}
+
+	// ID3v2 can be in front of MPEG, FLAC, TrueAudio and APE, so look after it. It's audio either way
+	if len(head) >= 10 && string(head[:3]) == "ID3" {
+		tagSize := int64(syncsafe(head[6:10])) + 10
+		if head[5]&0x10 != 0 {
+			tagSize += 10 // footer
+		}
+		head = readAtMost(r, buf[:], tagSize)
+		if format := sniffHead(head); format != FormatUnknown {
+			return format, true
+		}
+		if mpegSync(head) {
+			return FormatMPEG, true
+		}
+		return FormatUnknown, true
+	}
+
+	if format := sniffHead(head); format != FormatUnknown {
+		return format, true
+	}
+	// before looking for frames anywhere in the head, since their sync patterns can turn up in any payload
+	if notAudio(head) || (size <= int64(len(head)) && isText(head)) {
+		return FormatUnknown, false
+	}
+	if mpegSync(head) {
+		return FormatMPEG, true
+	}
+	return FormatUnknown, true
+}
+
+// notAudioSignatures start files that TagLib can't read, which are often found next to audio files
+var notAudioSignatures = []string{
+	"\x89PNG\r\n\x1a\n", "\xff\xd8\xff", "GIF87a", "GIF89a", "II*\x00", "MM\x00*", // images
+	"%PDF-", "{\\rtf", "<?xml", "<!DOCTYPE", "<html", "#EXTM3U", "\xef\xbb\xbf", // documents and playlists
+	"PK\x03\x04", "\x1f\x8b", "7z\xbc\xaf\x27\x1c", "Rar!\x1a\x07", "\xfd7zXZ\x00", "\x28\xb5\x2f\xfd", // archives
+	"\x7fELF", // executables
+}
+
+// notAudio reports whether b starts with the signature of a format that isn't audio
+func notAudio(b []byte) bool {
+	if len(b) >= 12 && string(b[:4]) == "RIFF" && string(b[8:12]) == "WEBP" {
+		return true
+	}
+	for _, sig := range notAudioSignatures {
+		if bytes.HasPrefix(b, []byte(sig)) {
+			return true
+		}
+	}
+	return false
+}
+
+// isText reports whether b is printable UTF-8 text
+func isText(b []byte) bool {
+	if !utf8.Valid(b) {
+		return false
+	}
+	for _, c := range b {
+		if c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f' || c == 0x7f {
+			return false
+		}
+	}
+	return true
+}
+
+// sniffHead recognizes formats by their signatures
+func sniffHead(b []byte) Format {
+	at := func(off int, sig string) bool {
+		return len(b) >= off+len(sig) && string(b[off:off+len(sig)]) == sig
+	}
+
+	switch {
+	case at(0, "fLaC"):
+		return FormatFLAC
+	case at(0, "OggS"):
+		// The first packet starts after the 27 byte page header and its segment table
+		if len(b) < 27 {
+			return FormatUnknown
+		}
+		packet := 27 + int(b[26])
+		switch {
+		case at(packet, "\x01vorbis"):
+			return FormatOggVorbis
+		case at(packet, "OpusHead"):
+			return FormatOggOpus
+		case at(packet, "Speex   "):
+			return FormatOggSpeex
+		case at(packet, "\x7fFLAC"), at(packet, "fLaC"):
+			return FormatOggFLAC
+		}
+	case at(0, "RIFF") && at(8, "WAVE"):
+		return FormatWAV
+	case at(0, "FORM") && (at(8, "AIFF") || at(8, "AIFC")):
+		return FormatAIFF
+	case at(4, "ftyp"):
+		return FormatMP4
+	case at(0, "MAC "):
+		return FormatAPE
+	case at(0, "wvpk"):
+		return FormatWavPack
+	case at(0, "MPCK"), at(0, "MP+"):
+		return FormatMPC
+	case at(0, "TTA1"):
+		return FormatTrueAudio
+	case at(0, "\x30\x26\xb2\x75\x8e\x66\xcf\x11\xa6\xd9\x00\xaa\x00\x62\xce\x6c"):
+		return FormatASF
+	case at(0, "DSD "):
+		return FormatDSF
+	case at(0, "FRM8"):
+		return FormatDSDIFF
+	case at(0, "ajkg"):
+		return FormatShorten
+	case at(0, "IMPM"):
+		return FormatIT
+	case at(0, "Extended Module: "):
+		return FormatXM
+	case at(44, "SCRM"):
+		return FormatS3M
+	}
+	if len(b) >= 1084 {
+		switch sig := string(b[1080:1084]); {
+		case sig == "M.K." || sig == "M!K!" || sig == "M&K!" || sig == "N.T." || sig == "FLT4" || sig == "FLT8",
+			sig == "CD81" || sig == "OKTA" || sig == "OCTA",
+			sig[1:] == "CHN" || sig[2:] == "CH" || sig[2:] == "CN":
+			return FormatMod
+		}
+	}
+	return FormatUnknown
+}
+
+var mpegBitrates = [5][15]int{
+	{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448}, // V1 L1
+	{0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},    // V1 L2
+	{0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},     // V1 L3
+	{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},    // V2 L1
+	{0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},         // V2 L2, L3
+}
+
+var mpegSampleRates = [4][3]int{
+	{11025, 12000, 8000},  // V2.5
+	{},                    // reserved
+	{22050, 24000, 16000}, // V2
+	{44100, 48000, 32000}, // V1
+}
+
+// mpegSync reports whether b has an MPEG audio or ADTS frame that is followed by another one.
+// Checking the next frame keeps stray sync bytes in other data from matching. Only a frame at the
+// start of b may run past its end unchecked
+func mpegSync(b []byte) bool {
+	for i := 0; i+6 <= len(b); i++ {
+		if b[i] != 0xff {
+			continue
+		}
+		n := frameLength(b[i:])
+		if n == 0 {
+			continue
+		}
+		next := i + n
+		if next+2 > len(b) {
+			if i == 0 {
+				return true
+			}
+			continue
+		}
+		if b[next] == 0xff && b[next+1]&0xe0 == 0xe0 && frameLength(b[next:]) != 0 {
+			return true
+		}
+	}
+	return false
+}
+
+// frameLength returns the length of the frame whose header starts b, or 0 if it isn't a valid header
+func frameLength(b []byte) int {
+	if len(b) < 6 || b[0] != 0xff {
+		return 0
+	}
+
+	// ADTS
+	if b[1]&0xf6 == 0xf0 {
+		if (b[2]>>2)&0xf > 12 {
+			return 0
+		}
+		if n := int(b[3]&0x3)<<11 | int(b[4])<<3 | int(b[5])>>5; n >= 7 {
+			return n
+		}
+		return 0
+	}
+
+	if b[1]&0xe0 != 0xe0 {
+		return 0
+	}
+	version, layer := (b[1]>>3)&0x3, (b[1]>>1)&0x3
+	bitrateIndex, rateIndex, padding := b[2]>>4, (b[2]>>2)&0x3, int(b[2]>>1)&0x1
+	if version == 1 || layer == 0 || bitrateIndex == 0 || bitrateIndex == 0xf || rateIndex == 3 {
+		return 0 // reserved values, or free format which can't be checked
+	}
+
+	table := 3 - int(layer) // layer bits are 3 for layer I
+	if version != 3 {
+		table = min(3+table, 4)
+	}
+	bitrate := mpegBitrates[table][bitrateIndex] * 1000
+	rate := mpegSampleRates[version][rateIndex]
+
+	switch {
+	case layer == 3:
+		return (12*bitrate/rate + padding) * 4
+	case layer == 1 && version != 3:
+		return 72*bitrate/rate + padding
+	default:
+		return 144*bitrate/rate + padding
+	}
+}
+
+func syncsafe(b []byte) uint32 {
+	return uint32(b[0]&0x7f)<<21 | uint32(b[1]&0x7f)<<14 | uint32(b[2]&0x7f)<<7 | uint32(b[3]&0x7f)
+}
+
+// readAtMost reads into buf at off, returning what it could
+func readAtMost(r io.ReaderAt, buf []byte, off int64) []byte {
+	n, _ := r.ReadAt(buf, off)
+	return buf[:n]
+}
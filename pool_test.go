@@ -0,0 +1,230 @@
+package taglib
+
+import (
+	"math"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+// These change the package's pool, so they don't run in parallel
+
+func TestPoolReuse(t *testing.T) {
+	drainPool(t)
+	key := poolKey{readOnly: true}
+
+	m, err := getModule(key)
+	nilErr(t, err)
+	eq(t, len(pool.sem), 1)
+	_, err = m.flush()
+	nilErr(t, err)
+	m.close()
+	eq(t, len(pool.sem), 0)
+
+	again, err := getModule(key)
+	nilErr(t, err)
+	eq(t, again, m)
+	again.close()
+
+	// a different mount doesn't get it
+	other, err := getModule(poolKey{root: t.TempDir(), readOnly: true})
+	nilErr(t, err)
+	if other == m {
+		t.Fatalf("got an instance with a different mount")
+	}
+	other.close()
+	eq(t, len(pool.sem), 0)
+}
+
+func TestPoolWornUses(t *testing.T) {
+	drainPool(t)
+	setPoolVar(t, &moduleMaxUses, 3)
+	key := poolKey{readOnly: true}
+
+	m, err := getModule(key)
+	nilErr(t, err)
+	for range 2 {
+		_, err := m.flush()
+		nilErr(t, err)
+	}
+	m.close()
+
+	// two calls in, so it's still reused
+	again, err := getModule(key)
+	nilErr(t, err)
+	eq(t, again, m)
+	_, err = again.flush()
+	nilErr(t, err)
+	again.close()
+
+	fresh, err := getModule(key)
+	nilErr(t, err)
+	if fresh == m {
+		t.Fatalf("reused an instance after %d calls", moduleMaxUses)
+	}
+	fresh.close()
+	eq(t, len(pool.sem), 0)
+}
+
+func TestPoolWornMemory(t *testing.T) {
+	drainPool(t)
+	key := poolKey{readOnly: true}
+
+	m, err := getModule(key)
+	nilErr(t, err)
+	_, err = m.flush()
+	nilErr(t, err)
+	setPoolVar(t, &moduleMaxMemory, m.mod.Memory().Size()-1)
+	m.close()
+
+	fresh, err := getModule(key)
+	nilErr(t, err)
+	if fresh == m {
+		t.Fatalf("reused an instance past the memory limit")
+	}
+	fresh.close()
+	eq(t, len(pool.sem), 0)
+}
+
+func TestPoolTrap(t *testing.T) {
+	drainPool(t)
+	key := poolKey{readOnly: true}
+
+	m, err := getModule(key)
+	nilErr(t, err)
+	// a path past the end of memory
+	if _, err := m.call(exportFileTags, math.MaxUint32-1, 0, 0); err == nil {
+		t.Fatalf("expected a trap")
+	}
+	eq(t, m.broken, true)
+	m.close()
+	eq(t, len(pool.sem), 0)
+
+	fresh, err := getModule(key)
+	nilErr(t, err)
+	if fresh == m {
+		t.Fatalf("reused an instance after a trap")
+	}
+	fresh.close()
+}
+
+func TestPoolEviction(t *testing.T) {
+	drainPool(t)
+
+	// uncounted, so that there can be more than poolSize at once
+	var mods []*module
+	for range poolSize + 1 {
+		m, err := checkout(poolKey{root: t.TempDir(), readOnly: true}, false)
+		nilErr(t, err)
+		mods = append(mods, m)
+	}
+	for _, m := range mods {
+		m.close()
+	}
+	eq(t, len(pool.sem), 0)
+
+	pool.mu.Lock()
+	idle := pool.idle
+	pool.mu.Unlock()
+	eq(t, len(idle), poolSize)
+	for i, m := range idle {
+		eq(t, m, mods[i+1]) // the least recently used went first
+	}
+}
+
+func TestPoolSemaphore(t *testing.T) {
+	drainPool(t)
+	key := poolKey{readOnly: true}
+
+	var mods []*module
+	for range poolSize {
+		m, err := getModule(key)
+		nilErr(t, err)
+		mods = append(mods, m)
+	}
+	eq(t, len(pool.sem), poolSize)
+
+	got := make(chan *module)
+	go func() {
+		m, err := getModule(key)
+		if err != nil {
+			panic(err)
+		}
+		got <- m
+	}()
+	select {
+	case <-got:
+		t.Fatalf("got more than %d instances", poolSize)
+	case <-time.After(50 * time.Millisecond):
+	}
+
+	mods[0].close()
+	select {
+	case m := <-got:
+		m.close()
+	case <-time.After(5 * time.Second):
+		t.Fatalf("a returned instance didn't free a slot")
+	}
+	for _, m := range mods[1:] {
+		m.close()
+	}
+	eq(t, len(pool.sem), 0)
+}
+
+func TestPoolMemoryFlat(t *testing.T) {
+	drainPool(t)
+
+	path, err := filepath.Abs("testdata/eg.flac")
+	nilErr(t, err)
+	m, err := getModule(poolKey{root: mountRoot(path), readOnly: true})
+	nilErr(t, err)
+	defer m.close()
+
+	read := func(n int) uint32 {
+		for range n {
+			// the image data is the largest allocation by far
+			_, ok, err := m.fileReadAll(wasmPath(path), FieldTags|FieldProperties|FieldImageDetails, ReadAverage, newHint(FormatFLAC, 0))
+			nilErr(t, err)
+			eq(t, ok, true)
+		}
+		return m.mod.Memory().Size()
+	}
+
+	// the arena is rewound before every call, so memory stops growing once it's big enough for one
+	warm := read(20)
+	eq(t, read(500), warm)
+}
+
+// drainPool closes the idle instances left by other tests, and checks that all slots are free
+func drainPool(t *testing.T) {
+	t.Helper()
+	eq(t, len(pool.sem), 0)
+
+	pool.mu.Lock()
+	idle := pool.idle
+	pool.idle = nil
+	pool.mu.Unlock()
+	for _, m := range idle {
+		closeInstance(m)
+	}
+}
+
+// setPoolVar sets one of the pool's limits until the end of the test
+func setPoolVar[T any](t *testing.T, v *T, value T) {
+	prev := *v
+	*v = value
+	t.Cleanup(func() { *v = prev })
+}
+
+func nilErr(t testing.TB, err error) {
+	if err != nil {
+		t.Helper()
+		t.Fatalf("err: %v", err)
+	}
+}
+func eq[T comparable](t testing.TB, a, b T) {
+	if a != b {
+		t.Helper()
+		t.Fatalf("%v != %v", a, b)
+	}
+}
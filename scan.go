@@ -0,0 +1,212 @@
+package taglib
+
+import (
+	"context"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"slices"
+	"strings"
+	"sync"
+)
+
+// ScanExtensions are the lowercase file extensions that [Scan] reads by default.
+var ScanExtensions = []string{
+	".3g2", ".aac", ".aif", ".aifc", ".aiff", ".ape", ".asf", ".dff", ".dsdiff", ".dsf", ".flac", ".it",
+	".m4a", ".m4b", ".m4p", ".m4r", ".mod", ".mp2", ".mp3", ".mp4", ".mpc", ".oga", ".ogg", ".opus",
+	".s3m", ".shn", ".spx", ".tta", ".wav", ".wma", ".wv", ".xm",
+}
+
+// ScanOptions configures [Scan].
+type ScanOptions struct {
+	// Workers is the number of files read at once. Each worker checks out a WASM instance from the pool per file,
+	// so the consumer can read files itself while receiving. It defaults to, and is capped at, GOMAXPROCS.
+	Workers int
+	// Fields selects what is read from each file. It defaults to [FieldTags].
+	Fields Field
+	// Style is how accurately audio properties are read with [FieldProperties]. [ReadFast] suits listings.
+	Style ReadStyle
+	// Extensions are the lowercase extensions of the files to read, including the dot. It defaults to [ScanExtensions].
+	Extensions []string
+	// FollowSymlinks makes the walk follow symbolic links to files and directories.
+	// Links to a directory that is already being walked are skipped.
+	FollowSymlinks bool
+}
+
+// ScanResult is a file read by [Scan]. [Result.Err] is set if the file, or the directory at Path, couldn't be read.
+type ScanResult struct {
+	Path string
+	Result
+}
+
+// Scan walks the tree at root and reads every audio file in it, sending the results in the order they complete.
+// The walk and the workers wait for results to be received, so a slow consumer doesn't cause results to pile up.
+// The channel is closed once everything is read, or soon after ctx is done.
+func Scan(ctx context.Context, root string, opts ScanOptions) <-chan ScanResult {
+	workers := opts.Workers
+	if workers <= 0 || workers > poolSize {
+		workers = poolSize
+	}
+	fields := opts.Fields
+	if fields == 0 {
+		fields = FieldTags
+	}
+	exts := opts.Extensions
+	if exts == nil {
+		exts = ScanExtensions
+	}
+
+	results := make(chan ScanResult, workers)
+	send := func(r ScanResult) bool {
+		select {
+		case results <- r:
+			return true
+		case <-ctx.Done():
+			return false
+		}
+	}
+
+	// Workers share one queue. Since no file is tied to a worker, an idle worker just takes the next path
+	paths := make(chan string, workers)
+	go func() {
+		defer close(paths)
+
+		w := walker{ctx: ctx, exts: exts, follow: opts.FollowSymlinks, paths: paths, send: send}
+		root, err := filepath.Abs(root)
+		if err != nil {
+			send(ScanResult{Path: root, Result: Result{Err: err}})
+			return
+		}
+		var parents []os.FileInfo
+		if w.follow {
+			info, err := os.Stat(root)
+			if err != nil {
+				send(ScanResult{Path: root, Result: Result{Err: err}})
+				return
+			}
+			parents = append(parents, info)
+		}
+		w.walk(root, parents)
+	}()
+
+	var wg sync.WaitGroup
+	for range workers {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			scanWorker(ctx, fields, opts.Style, paths, send)
+		}()
+	}
+	go func() {
+		wg.Wait()
+		close(results)
+	}()
+
+	return results
+}
+
+// scanWorker reads paths until paths is closed or ctx is done. It checks out an instance per file and returns it
+// before sending the result, so that a consumer that reads files itself while receiving can always get one. Idle
+// instances are reused for files in the same directory, so this costs little over keeping one checked out
+func scanWorker(ctx context.Context, fields Field, style ReadStyle, paths <-chan string, send func(ScanResult) bool) {
+	for path := range paths {
+		if ctx.Err() != nil {
+			return
+		}
+		if !send(ScanResult{Path: path, Result: scanFile(path, fields, style)}) {
+			return
+		}
+	}
+}
+
+func scanFile(path string, fields Field, style ReadStyle) Result {
+	// Files that clearly aren't audio are turned away before they cost an instance
+	format, err := DetectFormat(path)
+	if err != nil {
+		return Result{Err: err}
+	}
+
+	mod, err := newModuleRO(path)
+	if err != nil {
+		return Result{Err: err}
+	}
+	defer mod.close()
+
+	res, ok, err := mod.fileReadAll(wasmPath(path), fields, style, newHint(format, 0))
+	res.Format = format
+	switch {
+	case err != nil:
+		res.Err = err
+	case !ok:
+		res.Err = ErrInvalidFile
+	}
+	return res
+}
+
+type walker struct {
+	ctx    context.Context
+	exts   []string
+	follow bool
+	paths  chan<- string
+	send   func(ScanResult) bool
+}
+
+// walk sends the audio files under dir to w.paths. When following symlinks, parents holds the directories
+// being walked so that loops can be detected. It returns false if the walk should stop
+func (w *walker) walk(dir string, parents []os.FileInfo) bool {
+	entries, err := os.ReadDir(dir)
+	if err != nil && !w.send(ScanResult{Path: dir, Result: Result{Err: err}}) {
+		return false
+	}
+
+	for _, entry := range entries {
+		path := filepath.Join(dir, entry.Name())
+
+		typ := entry.Type()
+		var info os.FileInfo
+		if typ&fs.ModeSymlink != 0 {
+			if !w.follow {
+				continue
+			}
+			if info, err = os.Stat(path); err != nil {
+				if !w.send(ScanResult{Path: path, Result: Result{Err: err}}) {
+					return false
+				}
+				continue
+			}
+			typ = info.Mode().Type()
+		}
+
+		switch {
+		case typ.IsDir():
+			if w.follow {
+				if info == nil {
+					if info, err = entry.Info(); err != nil {
+						continue
+					}
+				}
+				if slices.ContainsFunc(parents, func(p os.FileInfo) bool { return os.SameFile(p, info) }) {
+					continue
+				}
+				if !w.walk(path, append(parents, info)) {
+					return false
+				}
+				continue
+			}
+			if !w.walk(path, nil) {
+				return false
+			}
+
+		case typ.IsRegular():
+			if !slices.Contains(w.exts, strings.ToLower(filepath.Ext(path))) {
+				continue
+			}
+			select {
+			case w.paths <- path:
+			case <-w.ctx.Done():
+				return false
+			}
+		}
+	}
+	return true
+}
@@ -0,0 +1,205 @@
+package taglib
+
+import (
+	"context"
+	"errors"
+	"fmt"
+	"io"
+
+	"github.com/tetratelabs/wazero"
+	"github.com/tetratelabs/wazero/api"
+)
+
+// ReadTagsFrom reads all metadata tags from the audio file behind r. TagLib pulls only the ranges of the file it
+// needs through r, so it doesn't have to be on local disk.
+func ReadTagsFrom(r io.ReadSeeker) (map[string][]string, error) {
+	mod, err := newModuleMem()
+	if err != nil {
+		return nil, fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	mod.stream = &hostStream{rs: r}
+	defer func() { mod.stream = nil }()
+
+	tags, err := mod.streamTags()
+	if err != nil {
+		return nil, fmt.Errorf("call: %w", err)
+	}
+	if err := mod.stream.err; err != nil {
+		return nil, fmt.Errorf("stream: %w", err)
+	}
+	if tags == nil {
+		return nil, ErrInvalidFile
+	}
+	return tags, nil
+}
+
+// WriteTagsTo writes the metadata key-values pairs to the audio file behind rw, like [WriteTags].
+// If the file has to shrink, rw must also have a Truncate(int64) error method, like [os.File] does.
+func WriteTagsTo(rw io.ReadWriteSeeker, tags map[string][]string, opts WriteOption) error {
+	mod, err := newModuleMem()
+	if err != nil {
+		return fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	mod.stream = &hostStream{rs: rw, w: rw}
+	defer func() { mod.stream = nil }()
+
+	out, err := mod.streamWriteTags(tags, opts)
+	if err != nil {
+		return fmt.Errorf("call: %w", err)
+	}
+	if err := mod.stream.err; err != nil {
+		return fmt.Errorf("stream: %w", err)
+	}
+	if !out {
+		return ErrSavingFile
+	}
+	return nil
+}
+
+// hostStream is the stream that host_stream in taglib.cpp calls into during a call. The guest can't handle
+// errors, so the first one is kept to be returned after the call and the guest sees a short read instead
+type hostStream struct {
+	rs  io.ReadSeeker
+	w   io.Writer // nil when read-only
+	err error
+}
+
+// shiftChunk is the buffer size used to move the tail of a file for inserts and removals
+const shiftChunk = 64 * 1024
+
+func (s *hostStream) fail(err error) {
+	if s.err == nil {
+		s.err = err
+	}
+}
+
+func (s *hostStream) read(p []byte) int {
+	n, err := io.ReadFull(s.rs, p)
+	if err != nil && !errors.Is(err, io.EOF) && !errors.Is(err, io.ErrUnexpectedEOF) {
+		s.fail(err)
+	}
+	return n
+}
+
+func (s *hostStream) write(p []byte) {
+	if _, err := s.w.Write(p); err != nil {
+		s.fail(err)
+	}
+}
+
+func (s *hostStream) seek(offset int64, whence int) int64 {
+	pos, err := s.rs.Seek(offset, whence)
+	if err != nil {
+		s.fail(err)
+	}
+	return pos
+}
+
+func (s *hostStream) length() int64 {
+	pos := s.seek(0, io.SeekCurrent)
+	end := s.seek(0, io.SeekEnd)
+	s.seek(pos, io.SeekStart)
+	return end
+}
+
+func (s *hostStream) readAt(p []byte, off int64) int {
+	s.seek(off, io.SeekStart)
+	return s.read(p)
+}
+
+func (s *hostStream) writeAt(p []byte, off int64) {
+	s.seek(off, io.SeekStart)
+	s.write(p)
+}
+
+// insert writes data at start over replace bytes, moving the rest of the file in chunks to make room
+func (s *hostStream) insert(data []byte, start int64, replace int64) {
+	end := s.length()
+	from := min(start+replace, end)
+	delta := int64(len(data)) - (from - start)
+
+	buf := make([]byte, min(shiftChunk, max(end-from, 0)))
+	switch {
+	case delta > 0:
+		// Move the tail back to front so nothing is overwritten before it's read
+		for pos := end; pos > from && s.err == nil; {
+			n := min(int64(len(buf)), pos-from)
+			pos -= n
+			s.readAt(buf[:n], pos)
+			s.writeAt(buf[:n], pos+delta)
+		}
+	case delta < 0:
+		for pos := from; pos < end && s.err == nil; {
+			n := min(int64(len(buf)), end-pos)
+			s.readAt(buf[:n], pos)
+			s.writeAt(buf[:n], pos+delta)
+			pos += n
+		}
+		s.truncate(end + delta)
+	}
+	s.writeAt(data, start)
+}
+
+func (s *hostStream) truncate(length int64) {
+	t, ok := s.w.(interface{ Truncate(int64) error })
+	if !ok {
+		s.fail(fmt.Errorf("can't shrink a %T without a Truncate method", s.w))
+		return
+	}
+	if err := t.Truncate(length); err != nil {
+		s.fail(err)
+	}
+}
+
+// moduleKey finds the calling *module from the context of a host function
+type moduleKey struct{}
+
+func streamOf(ctx context.Context) *hostStream {
+	m, _ := ctx.Value(moduleKey{}).(*module)
+	if m == nil || m.stream == nil {
+		panic("stream function called without a stream")
+	}
+	return m.stream
+}
+
+// guestBytes returns a view of guest memory, so reads and writes go straight between it and the stream
+func guestBytes(mod api.Module, ptr, length uint32) []byte {
+	b, ok := mod.Memory().Read(ptr, length)
+	if !ok {
+		panic("memory error")
+	}
+	return b
+}
+
+// exportStreamFuncs adds the functions that host_stream in taglib.cpp imports
+func exportStreamFuncs(b wazero.HostModuleBuilder) wazero.HostModuleBuilder {
+	return b.
+		NewFunctionBuilder().WithFunc(func(ctx context.Context, mod api.Module, ptr, length uint32) uint32 {
+		return uint32(streamOf(ctx).read(guestBytes(mod, ptr, length)))
+	}).Export("taglib_stream_read").
+		NewFunctionBuilder().WithFunc(func(ctx context.Context, mod api.Module, ptr, length uint32) {
+		streamOf(ctx).write(guestBytes(mod, ptr, length))
+	}).Export("taglib_stream_write").
+		NewFunctionBuilder().WithFunc(func(ctx context.Context, mod api.Module, ptr, length uint32, start int64, replace uint32) {
+		streamOf(ctx).insert(guestBytes(mod, ptr, length), start, int64(replace))
+	}).Export("taglib_stream_insert").
+		NewFunctionBuilder().WithFunc(func(ctx context.Context, start int64, length uint32) {
+		streamOf(ctx).insert(nil, start, int64(length))
+	}).Export("taglib_stream_remove").
+		NewFunctionBuilder().WithFunc(func(ctx context.Context, offset int64, whence uint32) {
+		streamOf(ctx).seek(offset, int(whence))
+	}).Export("taglib_stream_seek").
+		NewFunctionBuilder().WithFunc(func(ctx context.Context) int64 {
+		return streamOf(ctx).seek(0, io.SeekCurrent)
+	}).Export("taglib_stream_tell").
+		NewFunctionBuilder().WithFunc(func(ctx context.Context) int64 {
+		return streamOf(ctx).length()
+	}).Export("taglib_stream_length").
+		NewFunctionBuilder().WithFunc(func(ctx context.Context, length int64) {
+		streamOf(ctx).truncate(length)
+	}).Export("taglib_stream_truncate")
+}
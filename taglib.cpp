@@ -1,101 +1,484 @@
 //go:build ignore
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <vector>
 
+#include "aifffile.h"
+#include "apefile.h"
+#include "apetag.h"
+#include "asffile.h"
+#include "dsdifffile.h"
+#include "dsffile.h"
 #include "fileref.h"
+#include "flacfile.h"
+#include "id3v1tag.h"
+#include "id3v2tag.h"
+#include "itfile.h"
+#include "modfile.h"
+#include "mp4file.h"
+#include "mpcfile.h"
+#include "mpegfile.h"
+#include "oggflacfile.h"
+#include "opusfile.h"
+#include "s3mfile.h"
+#include "shortenfile.h"
+#include "speexfile.h"
+#include "tiostream.h"
 #include "tpropertymap.h"
+#include "trueaudiofile.h"
+#include "vorbisfile.h"
+#include "wavfile.h"
+#include "wavpackfile.h"
+#include "xmfile.h"
 
-// Size must come first so that we know how much of data to read
+// Size must come first so that we know how much of data to read. hash is only set when asked for, so that the
+// host can skip copying data it already has
 struct picture {
   unsigned int length;
-  char *data;
+  const char *data;
+  uint64_t hash;
 };
 
+// Bump allocator for everything handed to or received from the host. Nothing is freed individually, instead the
+// host calls taglib_reset before each call which rewinds it in O(1). Chunks are kept for reuse, so instance
+// memory stays flat once the largest call has been seen
+namespace arena {
+
+struct alignas(16) chunk {
+  chunk *next;
+  size_t cap;
+  size_t used;
+
+  char *data() { return reinterpret_cast<char *>(this + 1); }
+};
+
+static const size_t chunk_size = 64 * 1024;
+
+static chunk *head = nullptr;
+static chunk *cur = nullptr;
+static size_t last = 0; // offset of the latest allocation in cur, so that it can grow in place
+static std::vector<TagLib::ByteVector> kept; // handed to the host in place, see keep
+
+size_t align(size_t n) { return (n + 15) & ~size_t(15); }
+
+void *alloc(size_t size) {
+  size = align(size);
+  if (!cur || cur->used + size > cur->cap) {
+    chunk *next = cur ? cur->next : head;
+    if (next && next->cap >= size) {
+      cur = next;
+      cur->used = 0;
+    } else {
+      size_t cap = std::max(size, chunk_size);
+      chunk *c = static_cast<chunk *>(malloc(sizeof(chunk) + cap));
+      if (!c)
+        return nullptr;
+      c->cap = cap;
+      c->used = 0;
+      if (cur) {
+        c->next = cur->next;
+        cur->next = c;
+      } else {
+        c->next = head;
+        head = c;
+      }
+      cur = c;
+    }
+  }
+  last = cur->used;
+  cur->used += size;
+  return cur->data() + last;
+}
+
+// Resizes the allocation at p, which is cheap when it's the latest one
+void *grow(void *p, size_t old, size_t size) {
+  if (p && p == cur->data() + last && last + align(size) <= cur->cap) {
+    cur->used = last + align(size);
+    return p;
+  }
+  void *np = alloc(size);
+  if (np && p)
+    memcpy(np, p, old);
+  return np;
+}
+
+void reset() {
+  cur = head;
+  if (cur)
+    cur->used = 0;
+  kept.clear();
+}
+
+template <typename T> T *make(size_t n = 1) {
+  return static_cast<T *>(alloc(sizeof(T) * n));
+}
+
+// Returns the data of v, which stays valid after whatever v came from is destroyed. The const overload of
+// data() is used so that the shared buffer isn't detached and copied
+const char *keep(const TagLib::ByteVector &v) {
+  kept.push_back(v);
+  return static_cast<const TagLib::ByteVector &>(kept.back()).data();
+}
+
+} // namespace arena
+
+// Rewinds the arena and allocates room for the arguments of the next call, so that the host can start
+// a call with one export call and write all of its arguments with one copy
+__attribute__((export_name("taglib_reset"))) void *taglib_reset(size_t args_size) {
+  arena::reset();
+  if (args_size == 0)
+    return nullptr;
+  return arena::alloc(args_size);
+}
+
 char *to_char_array(const TagLib::String &s) {
   const std::string str = s.to8Bit(true);
-  return ::strdup(str.c_str());
+  char *buf = arena::make<char>(str.size() + 1);
+  if (buf)
+    memcpy(buf, str.c_str(), str.size() + 1);
+  return buf;
 }
 
 TagLib::String to_string(const char *s) {
   return TagLib::String(s, TagLib::String::UTF8);
 }
 
-__attribute__((export_name("malloc"))) void *exported_malloc(size_t size) {
-  return malloc(size);
-}
+// Growable buffer of little endian u32s and length prefixed UTF-8 strings, handed to the host in one piece.
+// It starts with its own total size as a u32 so that the host can read the header and then the rest in one go
+class packer {
+public:
+  packer() { grow(256); u32(0); }
 
-__attribute__((export_name("taglib_file_tags"))) char **
-taglib_file_tags(const char *filename) {
-  TagLib::FileRef file(filename);
-  if (file.isNull())
-    return nullptr;
+  void u32(uint32_t v) {
+    reserve(4);
+    memcpy(buf + len, &v, 4);
+    len += 4;
+  }
 
-  auto properties = file.properties();
+  // Encodes straight from TagLib's UTF-16 storage, so no intermediate std::string is needed per value.
+  // If max isn't 0, only the characters that fit in max bytes are written. Returns the full length in bytes
+  uint32_t str(const TagLib::String &s, uint32_t max = 0) {
+    size_t want = s.size() * 3;
+    reserve(4 + (max ? std::min<size_t>(want, max) : want));
+    size_t start = len;
+    len += 4;
+    uint32_t full = 0;
+    for (auto it = s.begin(); it != s.end(); ++it) {
+      uint32_t c = uint32_t(*it);
+      if (c >= 0xd800 && c < 0xdc00 && it + 1 != s.end()) {
+        uint32_t lo = uint32_t(*(it + 1));
+        if (lo >= 0xdc00 && lo < 0xe000) {
+          c = 0x10000 + ((c - 0xd800) << 10) + (lo - 0xdc00);
+          ++it;
+        }
+      }
+      uint32_t n = c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+      if (!max || full + n <= max)
+        put_rune(c);
+      full += n;
+    }
+    uint32_t n = uint32_t(len - start - 4);
+    memcpy(buf + start, &n, 4);
+    return full;
+  }
 
+  char *finish() {
+    uint32_t n = uint32_t(len);
+    memcpy(buf, &n, 4);
+    return buf;
+  }
+
+private:
+  char *buf = nullptr;
   size_t len = 0;
-  for (const auto &kvs : properties)
-    len += kvs.second.size();
+  size_t cap = 0;
 
-  char **tags = static_cast<char **>(malloc(sizeof(char *) * (len + 1)));
-  if (!tags)
-    return nullptr;
+  void reserve(size_t n) {
+    if (len + n > cap)
+      grow(std::max(cap * 2, len + n));
+  }
+
+  void grow(size_t n) {
+    buf = static_cast<char *>(arena::grow(buf, len, n));
+    cap = n;
+  }
+
+  void put_rune(uint32_t c) {
+    reserve(4);
+    if (c < 0x80) {
+      buf[len++] = char(c);
+    } else if (c < 0x800) {
+      buf[len++] = char(0xc0 | (c >> 6));
+      buf[len++] = char(0x80 | (c & 0x3f));
+    } else if (c < 0x10000) {
+      buf[len++] = char(0xe0 | (c >> 12));
+      buf[len++] = char(0x80 | ((c >> 6) & 0x3f));
+      buf[len++] = char(0x80 | (c & 0x3f));
+    } else {
+      buf[len++] = char(0xf0 | (c >> 18));
+      buf[len++] = char(0x80 | ((c >> 12) & 0x3f));
+      buf[len++] = char(0x80 | ((c >> 6) & 0x3f));
+      buf[len++] = char(0x80 | (c & 0x3f));
+    }
+  }
+};
 
-  size_t i = 0;
+// Reads what packer produces
+class unpacker {
+public:
+  explicit unpacker(const char *buf) : p(buf), end(buf) {
+    if (!buf)
+      return;
+    uint32_t size;
+    memcpy(&size, buf, 4);
+    end = buf + size;
+    p += 4;
+  }
+
+  bool ok() const { return good; }
+
+  uint32_t u32() {
+    if (end - p < 4) {
+      good = false;
+      return 0;
+    }
+    uint32_t v;
+    memcpy(&v, p, 4);
+    p += 4;
+    return v;
+  }
+
+  TagLib::String str() {
+    uint32_t n = u32();
+    if (uint32_t(end - p) < n) {
+      good = false;
+      return TagLib::String();
+    }
+    TagLib::String s(TagLib::ByteVector(p, n), TagLib::String::UTF8);
+    p += n;
+    return s;
+  }
+
+  TagLib::ByteVector bytes() {
+    uint32_t n = u32();
+    if (uint32_t(end - p) < n) {
+      good = false;
+      return TagLib::ByteVector();
+    }
+    TagLib::ByteVector v(p, n);
+    p += n;
+    return v;
+  }
+
+private:
+  const char *p;
+  const char *end;
+  bool good = true;
+};
+
+// Packs the property map as
+//   u32 key count, u32 total value count, then per key: str key, u32 value count, str values...
+// If max_value isn't 0, values are cut to max_value bytes and a list of the ones that were follows as
+//   u32 count, then per value: str key, u32 value index, u32 full length
+void pack_tags(packer &p, const TagLib::PropertyMap &properties, uint32_t max_value = 0) {
+  struct truncated {
+    TagLib::String key;
+    uint32_t index;
+    uint32_t size;
+  };
+  std::vector<truncated> cut;
+
+  uint32_t values = 0;
   for (const auto &kvs : properties)
+    values += kvs.second.size();
+
+  p.u32(properties.size());
+  p.u32(values);
+  for (const auto &kvs : properties) {
+    p.str(kvs.first);
+    p.u32(kvs.second.size());
+    uint32_t i = 0;
     for (const auto &v : kvs.second) {
-      TagLib::String row = kvs.first + "\t" + v;
-      tags[i] = to_char_array(row);
+      uint32_t size = p.str(v, max_value);
+      if (max_value && size > max_value)
+        cut.push_back({kvs.first, i, size});
       i++;
     }
-  tags[len] = nullptr;
+  }
 
-  return tags;
+  if (!max_value)
+    return;
+  p.u32(cut.size());
+  for (const auto &t : cut) {
+    p.str(t.key);
+    p.u32(t.index);
+    p.u32(t.size);
+  }
 }
 
-static const uint8_t CLEAR = 1 << 0;
-static const uint8_t DIFF_SAVE = 1 << 1;
+// The host can pass what it already knows about a file as a hint: the format in the low byte, and for MPEG, a mask
+// of the tag types to read in the next. 0 means unknown, or all tag types
+enum format : uint8_t {
+  // Same order as Format in format.go
+  FORMAT_UNKNOWN,
+  FORMAT_MPEG,
+  FORMAT_FLAC,
+  FORMAT_MP4,
+  FORMAT_OGG_VORBIS,
+  FORMAT_OGG_OPUS,
+  FORMAT_OGG_SPEEX,
+  FORMAT_OGG_FLAC,
+  FORMAT_WAV,
+  FORMAT_AIFF,
+  FORMAT_APE,
+  FORMAT_WAVPACK,
+  FORMAT_MPC,
+  FORMAT_TRUEAUDIO,
+  FORMAT_ASF,
+  FORMAT_DSF,
+  FORMAT_DSDIFF,
+  FORMAT_SHORTEN,
+  FORMAT_MOD,
+  FORMAT_S3M,
+  FORMAT_IT,
+  FORMAT_XM,
+};
 
-__attribute__((export_name("taglib_file_write_tags"))) bool
-taglib_file_write_tags(const char *filename, const char **tags, uint8_t opts) {
-  if (!filename || !tags)
-    return false;
+static const uint8_t MPEG_ID3V1 = 1 << 0;
+static const uint8_t MPEG_ID3V2 = 1 << 1;
+static const uint8_t MPEG_APE = 1 << 2;
 
-  TagLib::FileRef file(filename);
-  if (file.isNull())
-    return false;
+// Constructs the File type for format directly, skipping FileRef's detection. Source is a FileName or an IOStream *
+template <typename Source>
+TagLib::File *new_file(Source source, uint8_t format, bool read_properties, TagLib::AudioProperties::ReadStyle style) {
+  switch (format) {
+  case FORMAT_MPEG:
+    return new TagLib::MPEG::File(source, read_properties, style);
+  case FORMAT_FLAC:
+    return new TagLib::FLAC::File(source, read_properties, style);
+  case FORMAT_MP4:
+    return new TagLib::MP4::File(source, read_properties, style);
+  case FORMAT_OGG_VORBIS:
+    return new TagLib::Ogg::Vorbis::File(source, read_properties, style);
+  case FORMAT_OGG_OPUS:
+    return new TagLib::Ogg::Opus::File(source, read_properties, style);
+  case FORMAT_OGG_SPEEX:
+    return new TagLib::Ogg::Speex::File(source, read_properties, style);
+  case FORMAT_OGG_FLAC:
+    return new TagLib::Ogg::FLAC::File(source, read_properties, style);
+  case FORMAT_WAV:
+    return new TagLib::RIFF::WAV::File(source, read_properties, style);
+  case FORMAT_AIFF:
+    return new TagLib::RIFF::AIFF::File(source, read_properties, style);
+  case FORMAT_APE:
+    return new TagLib::APE::File(source, read_properties, style);
+  case FORMAT_WAVPACK:
+    return new TagLib::WavPack::File(source, read_properties, style);
+  case FORMAT_MPC:
+    return new TagLib::MPC::File(source, read_properties, style);
+  case FORMAT_TRUEAUDIO:
+    return new TagLib::TrueAudio::File(source, read_properties, style);
+  case FORMAT_ASF:
+    return new TagLib::ASF::File(source, read_properties, style);
+  case FORMAT_DSF:
+    return new TagLib::DSF::File(source, read_properties, style);
+  case FORMAT_DSDIFF:
+    return new TagLib::DSDIFF::File(source, read_properties, style);
+  case FORMAT_SHORTEN:
+    return new TagLib::Shorten::File(source, read_properties, style);
+  case FORMAT_MOD:
+    return new TagLib::Mod::File(source, read_properties, style);
+  case FORMAT_S3M:
+    return new TagLib::S3M::File(source, read_properties, style);
+  case FORMAT_IT:
+    return new TagLib::IT::File(source, read_properties, style);
+  case FORMAT_XM:
+    return new TagLib::XM::File(source, read_properties, style);
+  }
+  return nullptr;
+}
+
+// Opens source as the format in hint, falling back to FileRef's detection if there is no hint or it was wrong
+template <typename Source>
+TagLib::FileRef open_ref(Source source, uint32_t hint, bool read_properties = true,
+                         TagLib::AudioProperties::ReadStyle style = TagLib::AudioProperties::Average) {
+  if (TagLib::File *f = new_file(source, uint8_t(hint), read_properties, style)) {
+    if (f->isValid())
+      return TagLib::FileRef(f);
+    delete f;
+  }
+  return TagLib::FileRef(source, read_properties, style);
+}
+
+// Like FileRef::properties, but an MPEG file only reads the tag types in the hint's mask. As with TagLib's own
+// tag union, that is the first of ID3v2, APE and ID3v1 that isn't empty
+TagLib::PropertyMap file_properties(const TagLib::FileRef &file, uint32_t hint) {
+  uint8_t tags = uint8_t(hint >> 8);
+  auto *mpeg = tags ? dynamic_cast<TagLib::MPEG::File *>(file.file()) : nullptr;
+  if (!mpeg)
+    return file.properties();
+
+  if (tags & MPEG_ID3V2 && mpeg->hasID3v2Tag() && !mpeg->ID3v2Tag()->isEmpty())
+    return mpeg->ID3v2Tag()->properties();
+  if (tags & MPEG_APE && mpeg->hasAPETag() && !mpeg->APETag()->isEmpty())
+    return mpeg->APETag()->properties();
+  if (tags & MPEG_ID3V1 && mpeg->hasID3v1Tag() && !mpeg->ID3v1Tag()->isEmpty())
+    return mpeg->ID3v1Tag()->properties();
+  return TagLib::PropertyMap();
+}
 
+char *file_tags(const TagLib::FileRef &file, uint32_t hint = 0, uint32_t max_value = 0) {
+  packer p;
+  pack_tags(p, file_properties(file, hint), max_value);
+  return p.finish();
+}
+
+static const uint8_t CLEAR = 1 << 0;
+static const uint8_t DIFF_SAVE = 1 << 1;
+static const uint8_t CLEAR_IMAGES = 1 << 2;
+
+// Applies tags packed like file_tags does. Keys with no values, or only one empty one, are removed.
+// Returns false if the tags don't need saving
+bool file_set_tags(TagLib::FileRef &file, const char *tags, uint8_t opts) {
   auto properties = file.properties();
   if (opts & CLEAR)
     properties.clear();
 
-  for (size_t i = 0; tags[i]; i++) {
-    TagLib::String row(tags[i], TagLib::String::UTF8);
-    if (auto ti = row.find("\t"); ti != -1) {
-      auto key = row.substr(0, ti);
-      auto value = row.substr(ti + 1);
-      if (value.isEmpty())
-        properties.erase(key);
-      else
-        properties.replace(key, value.split("\v"));
+  unpacker u(tags);
+  uint32_t keys = u.u32();
+  u.u32(); // total value count
+  for (uint32_t i = 0; i < keys && u.ok(); i++) {
+    auto key = u.str();
+    uint32_t n = u.u32();
+    if (n == 0) {
+      properties.erase(key);
+      continue;
     }
+    TagLib::StringList values;
+    for (uint32_t j = 0; j < n; j++)
+      values.append(u.str());
+    if (n == 1 && values.front().isEmpty()) {
+      properties.erase(key);
+      continue;
+    }
+    properties.replace(key, values);
   }
 
   if (opts & DIFF_SAVE) {
     if (file.properties() == properties)
-      return true;
+      return false;
   }
 
   file.setProperties(properties);
-  return file.save();
+  return true;
 }
 
-__attribute__((export_name("taglib_file_audioproperties"))) int *
-taglib_file_audioproperties(const char *filename) {
-  TagLib::FileRef file(filename);
-  if (file.isNull() || !file.audioProperties())
+int *file_audioproperties(const TagLib::FileRef &file) {
+  if (!file.audioProperties())
     return nullptr;
 
-  int *arr = static_cast<int *>(malloc(4 * sizeof(int)));
+  int *arr = arena::make<int>(4);
   if (!arr)
     return nullptr;
 
@@ -108,57 +491,910 @@ taglib_file_audioproperties(const char *filename) {
   return arr;
 }
 
-__attribute__((export_name("taglib_file_read_image"))) picture *
-taglib_file_read_image(const char *filename) {
-  TagLib::FileRef file(filename);
-  if (file.isNull() || !file.audioProperties())
+// 64 bit FNV-1a, which is fast, needs no tables, and is good enough to tell covers apart
+uint64_t fnv1a(const uint8_t *d, size_t n) {
+  uint64_t h = 14695981039346656037ull;
+  for (size_t i = 0; i < n; i++) {
+    h ^= d[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+picture *make_picture(const TagLib::ByteVector &v, bool hash) {
+  picture *pic = arena::make<picture>();
+  if (!pic)
     return nullptr;
+  pic->length = unsigned(v.size());
+  pic->data = arena::keep(v);
+  pic->hash = hash ? fnv1a(reinterpret_cast<const uint8_t *>(pic->data), v.size()) : 0;
+  return pic;
+}
 
+picture *file_read_image(const TagLib::FileRef &file, bool hash = false) {
   const auto& pictures = file.complexProperties("PICTURE");
   if (pictures.isEmpty())
     return nullptr;
 
-  picture *pic = (picture *)malloc(sizeof(picture));
   for (const auto &p: pictures) {
     const auto pictureType = p["pictureType"].toString();
     if (pictureType == "Front Cover") {
       auto v = p["data"].toByteVector();
-      if (!v.isEmpty()) {
-        pic->length = unsigned(v.size());
-        pic->data = v.data();
-        return pic;
-      }
+      if (!v.isEmpty())
+        return make_picture(v, hash);
     }
   }
 
   // If we couldn't find a front cover pick a random cover
-  auto v = pictures.front()["data"].toByteVector();
-  pic->length = unsigned(v.size());
-  pic->data = v.data();
-  return pic;
+  return make_picture(pictures.front()["data"].toByteVector(), hash);
+}
+
+// Maps the host's ReadStyle, where the zero value is TagLib's default, to TagLib's
+TagLib::AudioProperties::ReadStyle read_style(uint8_t style) {
+  switch (style) {
+  case 1:
+    return TagLib::AudioProperties::Fast;
+  case 2:
+    return TagLib::AudioProperties::Accurate;
+  default:
+    return TagLib::AudioProperties::Average;
+  }
+}
+
+// Reads the picture at index in the order of complexProperties("PICTURE"), as listed by taglib_file_read_all
+__attribute__((export_name("taglib_file_read_image_at"))) picture *
+taglib_file_read_image_at(const char *filename, uint32_t index, uint32_t hint) {
+  TagLib::FileRef file = open_ref(filename, hint, false);
+  if (file.isNull())
+    return nullptr;
+
+  const auto &pictures = file.complexProperties("PICTURE");
+  if (index >= pictures.size())
+    return nullptr;
+
+  return make_picture(pictures[index].value("data").toByteVector(), false);
+}
+
+__attribute__((export_name("taglib_file_tags"))) char *
+taglib_file_tags(const char *filename, uint32_t hint, uint32_t max_value) {
+  TagLib::FileRef file = open_ref(filename, hint, false);
+  if (file.isNull())
+    return nullptr;
+
+  return file_tags(file, hint, max_value);
+}
+
+// Reads one whole tag value, for values that a read with max_value cut short. Returns
+//   u32 size, u32 1 and str value if the value exists, or u32 0 if not
+__attribute__((export_name("taglib_file_tag_value"))) char *
+taglib_file_tag_value(const char *filename, const char *key, uint32_t index, uint32_t hint) {
+  TagLib::FileRef file = open_ref(filename, hint, false);
+  if (file.isNull())
+    return nullptr;
+
+  const TagLib::PropertyMap properties = file_properties(file, hint);
+  const auto it = properties.find(TagLib::String(key, TagLib::String::UTF8));
+
+  packer p;
+  if (it == properties.end() || index >= it->second.size()) {
+    p.u32(0);
+    return p.finish();
+  }
+  p.u32(1);
+  p.str(it->second[index]);
+  return p.finish();
+}
+
+static const uint32_t STATUS_OK = 0;
+static const uint32_t STATUS_INVALID_FILE = 1;
+
+// Reads the tags of each path in a packed list of strings, so that many files cost one call. hints has a u32
+// hint for each path. Returns
+//   u32 size, u32 file count, then per file: u32 status, and tags packed like file_tags if the status is ok
+__attribute__((export_name("taglib_file_tags_batch"))) char *
+taglib_file_tags_batch(const char *paths, const char *hints) {
+  unpacker u(paths);
+  uint32_t count = u.u32();
+
+  packer p;
+  p.u32(count);
+  for (uint32_t i = 0; i < count; i++) {
+    const std::string filename = u.str().to8Bit(true);
+    uint32_t hint;
+    memcpy(&hint, hints + 4 * i, 4);
+    TagLib::FileRef file = open_ref(filename.c_str(), hint, false);
+    if (file.isNull()) {
+      p.u32(STATUS_INVALID_FILE);
+      continue;
+    }
+    p.u32(STATUS_OK);
+    pack_tags(p, file_properties(file, hint));
+  }
+  return p.finish();
+}
+
+static const uint8_t KEYS_ONLY = 1 << 0;
+static const uint8_t ALL_KEYS = 1 << 1;
+
+// Reads only the tags with keys in a packed list of strings, so that values nobody asked for aren't converted and
+// copied. An empty list reads none of them, and with ALL_KEYS the list is ignored and all are read. With KEYS_ONLY
+// the values are left out too, returning
+//   u32 size, u32 key count, then per key: str key, u32 value count
+__attribute__((export_name("taglib_file_tags_keys"))) char *
+taglib_file_tags_keys(const char *filename, const char *keys, uint32_t hint, uint8_t opts) {
+  TagLib::FileRef file = open_ref(filename, hint, false);
+  if (file.isNull())
+    return nullptr;
+
+  TagLib::PropertyMap properties = file_properties(file, hint);
+  if (!(opts & ALL_KEYS)) {
+    unpacker u(keys);
+    uint32_t count = u.u32();
+    TagLib::PropertyMap selected;
+    for (uint32_t i = 0; i < count && u.ok(); i++) {
+      const auto it = properties.find(u.str());
+      if (it != properties.end())
+        selected.replace(it->first, it->second);
+    }
+    properties = selected;
+  }
+
+  packer p;
+  if (!(opts & KEYS_ONLY)) {
+    pack_tags(p, properties);
+    return p.finish();
+  }
+  p.u32(properties.size());
+  for (const auto &kvs : properties) {
+    p.str(kvs.first);
+    p.u32(kvs.second.size());
+  }
+  return p.finish();
+}
+
+__attribute__((export_name("taglib_file_write_tags"))) bool
+taglib_file_write_tags(const char *filename, const char *tags, uint8_t opts) {
+  if (!filename || !tags)
+    return false;
+
+  TagLib::FileRef file(filename);
+  if (file.isNull())
+    return false;
+
+  if (!file_set_tags(file, tags, opts))
+    return true;
+
+  return file.save();
+}
+
+__attribute__((export_name("taglib_file_audioproperties"))) int *
+taglib_file_audioproperties(const char *filename, uint8_t style, uint32_t hint) {
+  TagLib::FileRef file = open_ref(filename, hint, true, read_style(style));
+  if (file.isNull())
+    return nullptr;
+
+  return file_audioproperties(file);
+}
+
+static const uint8_t IMAGE_HASH = 1 << 0;
+
+// With IMAGE_HASH the picture's hash is set, so the host can check it before copying the data
+__attribute__((export_name("taglib_file_read_image"))) picture *
+taglib_file_read_image(const char *filename, uint32_t hint, uint8_t opts) {
+  TagLib::FileRef file = open_ref(filename, hint, false);
+  if (file.isNull())
+    return nullptr;
+
+  return file_read_image(file, opts & IMAGE_HASH);
+}
+
+// Read-only stream over a file's contents that the host copied into the arena, so that no filesystem is involved
+class memory_stream : public TagLib::IOStream {
+public:
+  memory_stream(const char *data, size_t size) : data(data), size(size) {}
+
+  TagLib::FileName name() const override { return ""; }
+
+  TagLib::ByteVector readBlock(size_t length) override {
+    if (pos >= size)
+      return TagLib::ByteVector();
+    size_t n = std::min(length, size - pos);
+    TagLib::ByteVector v(data + pos, n);
+    pos += n;
+    return v;
+  }
+
+  void writeBlock(const TagLib::ByteVector &) override {}
+  void insert(const TagLib::ByteVector &, TagLib::offset_t, size_t) override {}
+  void removeBlock(TagLib::offset_t, size_t) override {}
+  void truncate(TagLib::offset_t) override {}
+  bool readOnly() const override { return true; }
+  bool isOpen() const override { return true; }
+
+  void seek(TagLib::offset_t offset, Position p) override {
+    TagLib::offset_t base = p == Beginning ? 0 : p == Current ? TagLib::offset_t(pos) : TagLib::offset_t(size);
+    pos = size_t(std::clamp<TagLib::offset_t>(base + offset, 0, size));
+  }
+
+  TagLib::offset_t tell() const override { return pos; }
+  TagLib::offset_t length() override { return size; }
+
+private:
+  const char *data;
+  size_t size;
+  size_t pos = 0;
+};
+
+__attribute__((export_name("taglib_bytes_tags"))) char *
+taglib_bytes_tags(const char *buf, unsigned int length, uint32_t hint) {
+  memory_stream stream(buf, length);
+  TagLib::FileRef file = open_ref<TagLib::IOStream *>(&stream, hint, false);
+  if (file.isNull())
+    return nullptr;
+
+  return file_tags(file, hint);
+}
+
+__attribute__((export_name("taglib_bytes_audioproperties"))) int *
+taglib_bytes_audioproperties(const char *buf, unsigned int length, uint32_t hint) {
+  memory_stream stream(buf, length);
+  TagLib::FileRef file = open_ref<TagLib::IOStream *>(&stream, hint);
+  if (file.isNull())
+    return nullptr;
+
+  return file_audioproperties(file);
+}
+
+__attribute__((export_name("taglib_bytes_read_image"))) picture *
+taglib_bytes_read_image(const char *buf, unsigned int length, uint32_t hint) {
+  memory_stream stream(buf, length);
+  TagLib::FileRef file = open_ref<TagLib::IOStream *>(&stream, hint, false);
+  if (file.isNull())
+    return nullptr;
+
+  return file_read_image(file);
+}
+
+// Stream functions provided by the host, see stream.go. They act on the stream the host bound for the current call
+#define HOST_IMPORT(name) __attribute__((import_module("env"), import_name(name)))
+
+HOST_IMPORT("taglib_stream_read") uint32_t host_stream_read(char *buf, uint32_t length);
+HOST_IMPORT("taglib_stream_write") void host_stream_write(const char *buf, uint32_t length);
+HOST_IMPORT("taglib_stream_insert") void host_stream_insert(const char *buf, uint32_t length, int64_t start, uint32_t replace);
+HOST_IMPORT("taglib_stream_remove") void host_stream_remove(int64_t start, uint32_t length);
+HOST_IMPORT("taglib_stream_seek") void host_stream_seek(int64_t offset, uint32_t whence);
+HOST_IMPORT("taglib_stream_tell") int64_t host_stream_tell();
+HOST_IMPORT("taglib_stream_length") int64_t host_stream_length();
+HOST_IMPORT("taglib_stream_truncate") void host_stream_truncate(int64_t length);
+
+// Stream backed by a host io.ReadSeeker, so that TagLib only pulls the ranges it needs across the boundary
+class host_stream : public TagLib::IOStream {
+public:
+  explicit host_stream(bool read_only) : read_only(read_only) {}
+
+  TagLib::FileName name() const override { return ""; }
+
+  TagLib::ByteVector readBlock(size_t length) override {
+    TagLib::ByteVector v(static_cast<unsigned int>(length), 0);
+    uint32_t n = host_stream_read(v.data(), uint32_t(length));
+    if (n < length)
+      v.resize(n);
+    return v;
+  }
+
+  void writeBlock(const TagLib::ByteVector &data) override {
+    if (!read_only)
+      host_stream_write(data.data(), data.size());
+  }
+
+  void insert(const TagLib::ByteVector &data, TagLib::offset_t start, size_t replace) override {
+    if (!read_only)
+      host_stream_insert(data.data(), data.size(), start, uint32_t(replace));
+  }
+
+  void removeBlock(TagLib::offset_t start, size_t length) override {
+    if (!read_only)
+      host_stream_remove(start, uint32_t(length));
+  }
+
+  void truncate(TagLib::offset_t length) override {
+    if (!read_only)
+      host_stream_truncate(length);
+  }
+
+  bool readOnly() const override { return read_only; }
+  bool isOpen() const override { return true; }
+
+  void seek(TagLib::offset_t offset, Position p) override { host_stream_seek(offset, uint32_t(p)); }
+  TagLib::offset_t tell() const override { return host_stream_tell(); }
+  TagLib::offset_t length() override { return host_stream_length(); }
+
+private:
+  bool read_only;
+};
+
+__attribute__((export_name("taglib_stream_tags"))) char *
+taglib_stream_tags() {
+  host_stream stream(true);
+  TagLib::FileRef file(&stream, false);
+  if (file.isNull())
+    return nullptr;
+
+  return file_tags(file);
+}
+
+__attribute__((export_name("taglib_stream_write_tags"))) bool
+taglib_stream_write_tags(const char *tags, uint8_t opts) {
+  if (!tags)
+    return false;
+
+  host_stream stream(false);
+  TagLib::FileRef file(&stream);
+  if (file.isNull())
+    return false;
+
+  if (!file_set_tags(file, tags, opts))
+    return true;
+
+  return file.save();
+}
+
+// Descriptor of an embedded picture, without its data. The fields after length are only set with READ_IMAGE_DETAILS
+struct image_info {
+  char *type;
+  char *mime_type;
+  char *description;
+  unsigned int length;
+  unsigned int width;
+  unsigned int height;
+  const char *detected_mime_type; // static, or null if the format wasn't recognized
+  uint64_t hash;                  // 8 byte aligned, at 32
+};
+
+uint32_t be16(const uint8_t *p) { return uint32_t(p[0]) << 8 | p[1]; }
+uint32_t be32(const uint8_t *p) { return be16(p) << 16 | be16(p + 2); }
+uint32_t le16(const uint8_t *p) { return uint32_t(p[1]) << 8 | p[0]; }
+uint32_t le24(const uint8_t *p) { return uint32_t(p[2]) << 16 | le16(p); }
+
+// Sets the detected MIME type and dimensions of the image in data from its header, without decoding it
+void inspect_image(const uint8_t *d, size_t n, image_info &img) {
+  if (n >= 24 && memcmp(d, "\x89PNG\r\n\x1a\n", 8) == 0 && memcmp(d + 12, "IHDR", 4) == 0) {
+    img.detected_mime_type = "image/png";
+    img.width = be32(d + 16);
+    img.height = be32(d + 20);
+    return;
+  }
+
+  if (n >= 10 && memcmp(d, "GIF8", 4) == 0) {
+    img.detected_mime_type = "image/gif";
+    img.width = le16(d + 6);
+    img.height = le16(d + 8);
+    return;
+  }
+
+  if (n >= 16 && memcmp(d, "RIFF", 4) == 0 && memcmp(d + 8, "WEBP", 4) == 0) {
+    img.detected_mime_type = "image/webp";
+    // A small lossless image can be shorter than the other two headers
+    if (n >= 30 && memcmp(d + 12, "VP8 ", 4) == 0 && d[23] == 0x9d && d[24] == 0x01 && d[25] == 0x2a) {
+      img.width = le16(d + 26) & 0x3fff;
+      img.height = le16(d + 28) & 0x3fff;
+    } else if (n >= 25 && memcmp(d + 12, "VP8L", 4) == 0 && d[20] == 0x2f) {
+      img.width = 1 + (d[21] | (d[22] & 0x3f) << 8);
+      img.height = 1 + (d[22] >> 6 | d[23] << 2 | (d[24] & 0x0f) << 10);
+    } else if (n >= 30 && memcmp(d + 12, "VP8X", 4) == 0) {
+      img.width = 1 + le24(d + 24);
+      img.height = 1 + le24(d + 27);
+    }
+    return;
+  }
+
+  if (n >= 4 && d[0] == 0xff && d[1] == 0xd8) {
+    img.detected_mime_type = "image/jpeg";
+    // Walk the segments up to the start of frame, which has the dimensions
+    size_t pos = 2;
+    while (pos + 4 <= n) {
+      if (d[pos] != 0xff) {
+        pos++;
+        continue;
+      }
+      uint8_t marker = d[pos + 1];
+      if (marker == 0xff) { // fill byte
+        pos++;
+        continue;
+      }
+      if (marker == 0x01 || (marker >= 0xd0 && marker <= 0xd8)) { // no length
+        pos += 2;
+        continue;
+      }
+      if (marker == 0xd9 || marker == 0xda) // end of image, or compressed data without a frame header first
+        return;
+      bool sof = marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc;
+      if (sof && pos + 9 <= n) {
+        img.height = be16(d + pos + 5);
+        img.width = be16(d + pos + 7);
+        return;
+      }
+      pos += 2 + be16(d + pos + 2);
+    }
+  }
+}
+
+// Everything needed to index a file, so that it's parsed only once
+struct file_info {
+  char *tags;
+  int *properties;
+  unsigned int image_count;
+  image_info *images;
+};
+
+static const uint8_t READ_TAGS = 1 << 0;
+static const uint8_t READ_PROPERTIES = 1 << 1;
+static const uint8_t READ_IMAGES = 1 << 2;
+static const uint8_t READ_IMAGE_DETAILS = 1 << 3;
+
+// Reads the parts of the file selected by fields, leaving the others null
+__attribute__((export_name("taglib_file_read_all"))) file_info *
+taglib_file_read_all(const char *filename, uint8_t fields, uint8_t style, uint32_t hint) {
+  TagLib::FileRef file = open_ref(filename, hint, fields & READ_PROPERTIES, read_style(style));
+  if (file.isNull())
+    return nullptr;
+
+  file_info *info = arena::make<file_info>();
+  if (!info)
+    return nullptr;
+
+  info->tags = fields & READ_TAGS ? file_tags(file, hint) : nullptr;
+  info->properties = fields & READ_PROPERTIES ? file_audioproperties(file) : nullptr;
+  info->image_count = 0;
+  info->images = nullptr;
+  if (!(fields & (READ_IMAGES | READ_IMAGE_DETAILS)))
+    return info;
+
+  const auto &pictures = file.complexProperties("PICTURE");
+  info->images = arena::make<image_info>(pictures.size());
+  if (info->images)
+    for (const auto &p : pictures) {
+      image_info &img = info->images[info->image_count++];
+      img.type = to_char_array(p.value("pictureType").toString());
+      img.mime_type = to_char_array(p.value("mimeType").toString());
+      img.description = to_char_array(p.value("description").toString());
+      const TagLib::ByteVector data = p.value("data").toByteVector();
+      img.length = data.size();
+      img.width = img.height = 0;
+      img.detected_mime_type = nullptr;
+      img.hash = 0;
+      if (fields & READ_IMAGE_DETAILS) {
+        const auto *d = reinterpret_cast<const uint8_t *>(data.data());
+        inspect_image(d, data.size(), img);
+        img.hash = fnv1a(d, data.size());
+      }
+    }
+
+  return info;
+}
+
+// Files opened with taglib_open stay parsed until taglib_close, so that one parse can serve several reads.
+// A handle is its index in the table plus one, so that 0 can mean invalid
+struct open_file {
+  TagLib::FileRef file;
+  bool dirty;
+};
+
+static std::vector<open_file *> handles;
+
+open_file *lookup(uint32_t handle) {
+  if (handle == 0 || handle > handles.size())
+    return nullptr;
+  return handles[handle - 1];
+}
+
+__attribute__((export_name("taglib_open"))) uint32_t
+taglib_open(const char *filename, uint32_t hint) {
+  // Only the format is used, so that saving can't drop tag types that weren't read
+  auto *f = new open_file{open_ref(filename, hint & 0xff), false};
+  if (f->file.isNull()) {
+    delete f;
+    return 0;
+  }
+
+  for (size_t i = 0; i < handles.size(); i++)
+    if (!handles[i]) {
+      handles[i] = f;
+      return uint32_t(i + 1);
+    }
+  handles.push_back(f);
+  return uint32_t(handles.size());
+}
+
+__attribute__((export_name("taglib_close"))) void
+taglib_close(uint32_t handle) {
+  if (auto *f = lookup(handle)) {
+    delete f;
+    handles[handle - 1] = nullptr;
+  }
+}
+
+__attribute__((export_name("taglib_handle_tags"))) char *
+taglib_handle_tags(uint32_t handle) {
+  auto *f = lookup(handle);
+  if (!f)
+    return nullptr;
+
+  return file_tags(f->file);
+}
+
+__attribute__((export_name("taglib_handle_audioproperties"))) int *
+taglib_handle_audioproperties(uint32_t handle) {
+  auto *f = lookup(handle);
+  if (!f)
+    return nullptr;
+
+  return file_audioproperties(f->file);
+}
+
+__attribute__((export_name("taglib_handle_read_image"))) picture *
+taglib_handle_read_image(uint32_t handle) {
+  auto *f = lookup(handle);
+  if (!f)
+    return nullptr;
+
+  return file_read_image(f->file);
+}
+
+__attribute__((export_name("taglib_handle_set_tags"))) bool
+taglib_handle_set_tags(uint32_t handle, const char *tags, uint8_t opts) {
+  auto *f = lookup(handle);
+  if (!f || !tags)
+    return false;
+
+  if (file_set_tags(f->file, tags, opts))
+    f->dirty = true;
+  return true;
+}
+
+__attribute__((export_name("taglib_handle_save"))) bool
+taglib_handle_save(uint32_t handle) {
+  auto *f = lookup(handle);
+  if (!f)
+    return false;
+
+  if (!f->dirty)
+    return true;
+  if (!f->file.save())
+    return false;
+  f->dirty = false;
+  return true;
+}
+
+// The PICTURE property an image is written as. Empty fields take the defaults that taglib_file_write_image has
+// always written
+TagLib::VariantMap picture_props(const TagLib::ByteVector &data, const TagLib::String &type,
+                                 const TagLib::String &mime_type, const TagLib::String &description) {
+  // https://github.com/taglib/taglib/blob/v2.0.2/examples/tagwriter.cpp#L187-L189
+  TagLib::String mimeType = mime_type;
+  if (mimeType.isEmpty())
+    mimeType = data.startsWith("\x89PNG\x0d\x0a\x1a\x0a") ? "image/png" : "image/jpeg";
+
+  return {
+    {"data", data},
+    {"pictureType", type.isEmpty() ? TagLib::String("Front Cover") : type},
+    {"mimeType", mimeType},
+    {"description", description.isEmpty() ? TagLib::String("Added by go-taglib") : description}
+  };
 }
 
-// TODO: Maybe allow user to set cover type?
 __attribute__((export_name("taglib_file_write_image"))) bool
 taglib_file_write_image(const char *filename, const char *buf, unsigned int length) {
   TagLib::FileRef file(filename);
   if (file.isNull() || !file.audioProperties())
     return false;
 
-  // https://github.com/taglib/taglib/blob/v2.0.2/examples/tagwriter.cpp#L187-L189
   TagLib::ByteVector data(buf, length);
-  TagLib::String mimeType = data.startsWith("\x89PNG\x0d\x0a\x1a\x0a") ? "image/png" : "image/jpeg";
+  file.setComplexProperties("PICTURE", {picture_props(data, "", "", "")});
+
+  return file.save();
+}
+
+static const uint32_t STATUS_SAVE_FAILED = 2;
+
+// Replaces the pictures of each path in a packed list of strings with one image. The image is copied out of the
+// arguments once, and since TagLib's types are implicitly shared every file refers to that same ByteVector.
+// opts is a packed list of strings: picture type, MIME type and description, which may be empty. Returns
+//   u32 size, u32 file count, then per file: u32 status
+__attribute__((export_name("taglib_file_write_image_many"))) char *
+taglib_file_write_image_many(const char *paths, const char *buf, unsigned int length, const char *opts) {
+  unpacker o(opts);
+  o.u32(); // count
+  const TagLib::String type = o.str();
+  const TagLib::String mime_type = o.str();
+  const TagLib::String description = o.str();
+  const TagLib::List<TagLib::VariantMap> pictures = {
+    picture_props(TagLib::ByteVector(buf, length), type, mime_type, description)
+  };
 
-  file.setComplexProperties("PICTURE", {
-    {
-      {"data", data},
-      {"pictureType", "Front Cover"},
-      {"mimeType", mimeType},
-      {"description", "Added by go-taglib"}
+  unpacker u(paths);
+  uint32_t count = u.u32();
+
+  packer p;
+  p.u32(count);
+  for (uint32_t i = 0; i < count; i++) {
+    const std::string filename = u.str().to8Bit(true);
+    TagLib::FileRef file(filename.c_str());
+    if (file.isNull() || !file.audioProperties()) {
+      p.u32(STATUS_INVALID_FILE);
+      continue;
     }
-  });
+    file.setComplexProperties("PICTURE", pictures);
+    p.u32(file.save() ? STATUS_OK : STATUS_SAVE_FAILED);
+  }
+  return p.finish();
+}
 
-  return file.save();
+// TagLib keeps existing padding on save only up to 1% of the file, at least its own minimum and at most 1 MiB, and
+// cuts anything more back to the minimum. See ID3v2::Tag::render and FLAC::File::save
+uint32_t padding_limit(TagLib::File *f, uint32_t min_padding) {
+  return uint32_t(std::clamp<TagLib::offset_t>(f->length() / 100, min_padding, 1024 * 1024));
+}
+
+// Padding is only grown once less than half of what was asked for would be left, so that every small edit after a
+// reservation doesn't cost a rewrite of its own
+bool needs_padding(int64_t padding, uint32_t size) { return padding < size / 2; }
+
+uint32_t syncsafe(const uint8_t *p) {
+  return uint32_t(p[0] & 0x7f) << 21 | uint32_t(p[1] & 0x7f) << 14 | uint32_t(p[2] & 0x7f) << 7 | (p[3] & 0x7f);
+}
+
+TagLib::ByteVector render_syncsafe(uint32_t n) {
+  TagLib::ByteVector v(4, 0);
+  for (int i = 0; i < 4; i++)
+    v[i] = char((n >> (21 - 7 * i)) & 0x7f);
+  return v;
+}
+
+// The ID3v2 tag at the start of an MPEG file, as found on disk
+struct id3v2_header {
+  bool present = false;
+  uint32_t tag_size = 0; // without the header
+};
+
+// Returns false if there's a tag whose padding can't be grown. Padding isn't allowed with a footer, and TagLib
+// writes neither extended headers nor v2.2 tags
+bool read_id3v2_header(TagLib::File *f, id3v2_header &tag) {
+  f->seek(0);
+  const TagLib::ByteVector header = f->readBlock(10);
+  if (!header.startsWith("ID3"))
+    return true;
+  const auto *h = reinterpret_cast<const uint8_t *>(header.data());
+  if (header.size() < 10 || h[3] < 3 || h[5] & 0x50)
+    return false;
+  tag.present = true;
+  tag.tag_size = syncsafe(h + 6);
+  return true;
+}
+
+// The padding that ID3v2::Tag::render would leave in a tag of tag_size, or a negative number if the frames no longer
+// fit and it has to grow
+int64_t id3v2_padding_after_save(const TagLib::ID3v2::Tag *tag, uint32_t tag_size) {
+  int64_t padding = tag_size;
+  for (const auto *frame : tag->frameList()) {
+    if (frame->header()->tagAlterPreservation())
+      continue;
+    const uint32_t size = frame->render().size();
+    if (size > 10) // empty frames are dropped
+      padding -= size;
+  }
+  return padding;
+}
+
+// Grows the tag by grow bytes of padding, or adds one of only padding if there isn't a tag yet
+void grow_id3v2_padding(TagLib::File *f, const id3v2_header &tag, uint32_t grow) {
+  const TagLib::ByteVector size = render_syncsafe(tag.tag_size + grow);
+  if (!tag.present) {
+    TagLib::ByteVector header("ID3\x04\x00\x00", 6);
+    header.append(size);
+    header.append(TagLib::ByteVector(grow, 0));
+    f->insert(header, 0, 0);
+    return;
+  }
+  f->insert(TagLib::ByteVector(grow, 0), 10 + tag.tag_size, 0);
+  f->seek(6);
+  f->writeBlock(size);
+}
+
+// The metadata blocks of a FLAC file, as found on disk
+struct flac_blocks {
+  TagLib::offset_t last = 0; // where the header of the last block is
+  uint8_t last_type = 0;
+  uint32_t last_length = 0;
+  int64_t replaced = 0; // bytes taken by the padding, comment and picture blocks, with their headers
+};
+
+bool read_flac_blocks(TagLib::File *f, flac_blocks &blocks) {
+  f->seek(0);
+  const TagLib::ByteVector header = f->readBlock(10);
+  const auto *h = reinterpret_cast<const uint8_t *>(header.data());
+  TagLib::offset_t pos = 0;
+  if (header.size() == 10 && header.startsWith("ID3"))
+    pos = 10 + syncsafe(h + 6) + (h[5] & 0x10 ? 10 : 0);
+
+  f->seek(pos);
+  if (!f->readBlock(4).startsWith("fLaC"))
+    return false;
+  for (pos += 4;;) {
+    f->seek(pos);
+    const TagLib::ByteVector block = f->readBlock(4);
+    if (block.size() < 4)
+      return false;
+    const auto *b = reinterpret_cast<const uint8_t *>(block.data());
+    const uint8_t type = b[0] & 0x7f;
+    const uint32_t length = uint32_t(b[1]) << 16 | be16(b + 2);
+    if (type == 1 || type == 4 || type == 6)
+      blocks.replaced += 4 + length;
+    if (b[0] & 0x80) {
+      blocks.last = pos;
+      blocks.last_type = type;
+      blocks.last_length = length;
+      return true;
+    }
+    pos += 4 + length;
+  }
+}
+
+// The padding that FLAC::File::save would leave, or a negative number if the metadata no longer fits and has to
+// grow. The save drops all padding blocks and renders the comment and pictures again, keeping the other blocks
+int64_t flac_padding_after_save(TagLib::FLAC::File *f, const flac_blocks &blocks) {
+  int64_t padding = blocks.replaced - 4; // the header of the new padding block
+  padding -= 4 + f->xiphComment(true)->render(false).size();
+  for (const auto *picture : f->pictureList())
+    padding -= 4 + picture->render().size();
+  return padding;
+}
+
+// Grows the metadata by grow bytes of padding, in the last block if that's padding, otherwise in a new one after it
+void grow_flac_padding(TagLib::File *f, const flac_blocks &blocks, uint32_t grow) {
+  const TagLib::offset_t end = blocks.last + 4 + blocks.last_length;
+  if (blocks.last_type == 1) {
+    const uint32_t length = blocks.last_length + grow;
+    f->insert(TagLib::ByteVector(grow, 0), end, 0);
+    f->seek(blocks.last + 1);
+    f->writeBlock(TagLib::ByteVector::fromUInt(length).mid(1, 3));
+    return;
+  }
+
+  const uint32_t length = std::max<uint32_t>(grow, 4) - 4;
+  TagLib::ByteVector block = TagLib::ByteVector::fromUInt(length);
+  block[0] = char(0x80 | 1);
+  block.append(TagLib::ByteVector(length, 0));
+  f->insert(block, end, 0);
+  f->seek(blocks.last);
+  f->writeBlock(TagLib::ByteVector(1, char(blocks.last_type)));
+}
+
+// Grows the padding after the tags of FLAC files and MPEG files with ID3v2 before a save, if the save would leave
+// less than half of size, so that it fits in place and later saves do too. size is capped by padding_limit. The file
+// is changed under TagLib, so it has to be opened again before it's saved. Returns whether the audio moved for it
+bool reserve_padding(TagLib::File *f, uint32_t size) {
+  if (auto *flac = dynamic_cast<TagLib::FLAC::File *>(f)) {
+    size = std::min(size, padding_limit(f, 4096));
+    flac_blocks blocks;
+    if (!read_flac_blocks(f, blocks))
+      return false;
+    const int64_t padding = flac_padding_after_save(flac, blocks);
+    if (!needs_padding(padding, size))
+      return false;
+    grow_flac_padding(f, blocks, uint32_t(size - padding));
+    return true;
+  }
+  if (auto *mpeg = dynamic_cast<TagLib::MPEG::File *>(f)) {
+    size = std::min(size, padding_limit(f, 1024));
+    const TagLib::ID3v2::Tag *id3v2 = mpeg->ID3v2Tag();
+    id3v2_header tag;
+    if (!id3v2 || id3v2->isEmpty() || !read_id3v2_header(f, tag))
+      return false;
+    const int64_t padding = id3v2_padding_after_save(id3v2, tag.tag_size);
+    if (!needs_padding(padding, size))
+      return false;
+    grow_id3v2_padding(f, tag, uint32_t(size - padding));
+    return true;
+  }
+  return false;
+}
+
+// Where the audio starts in FLAC and MPEG files, which changes when the tags in front of it are resized. Other formats
+// keep tags in other places, like the end of the file, so their length is used instead
+TagLib::offset_t audio_start(TagLib::File *f) {
+  if (dynamic_cast<TagLib::FLAC::File *>(f)) {
+    flac_blocks blocks;
+    if (read_flac_blocks(f, blocks))
+      return blocks.last + 4 + blocks.last_length;
+  }
+  if (dynamic_cast<TagLib::MPEG::File *>(f)) {
+    f->seek(0);
+    const TagLib::ByteVector header = f->readBlock(10);
+    const auto *h = reinterpret_cast<const uint8_t *>(header.data());
+    if (header.size() == 10 && header.startsWith("ID3"))
+      return 10 + syncsafe(h + 6) + (h[5] & 0x10 ? 10 : 0);
+    return 0;
+  }
+  return f->length();
+}
+
+// Applies the tags and images of taglib_file_apply to file, returning whether anything changed
+bool apply_mutation(TagLib::FileRef &file, const char *tags, const char *images, uint8_t opts) {
+  bool changed = file_set_tags(file, tags, opts | DIFF_SAVE);
+
+  bool images_changed = false;
+  unpacker u(images);
+  uint32_t count = u.u32();
+  TagLib::List<TagLib::VariantMap> pictures = file.complexProperties("PICTURE");
+  if (opts & CLEAR_IMAGES && !pictures.isEmpty()) {
+    pictures = TagLib::List<TagLib::VariantMap>();
+    images_changed = true;
+  }
+  for (uint32_t i = 0; i < count && u.ok(); i++) {
+    const TagLib::String type = u.str();
+    const TagLib::String mime_type = u.str();
+    const TagLib::String description = u.str();
+    const TagLib::VariantMap picture = picture_props(u.bytes(), type, mime_type, description);
+
+    const TagLib::String picture_type = picture.value("pictureType").toString();
+    for (auto it = pictures.begin(); it != pictures.end();) {
+      if (it->value("pictureType").toString() == picture_type)
+        it = pictures.erase(it);
+      else
+        ++it;
+    }
+    pictures.append(picture);
+    images_changed = true;
+  }
+  if (images_changed) {
+    file.setComplexProperties("PICTURE", pictures);
+    changed = true;
+  }
+  return changed;
+}
+
+// Applies tags, packed like file_tags does, and images, packed as
+//   u32 size, u32 count, then per image: str type, str MIME type, str description, str data
+// with a single save, and only if something changed. Each image replaces the existing ones of its type, and with
+// CLEAR_IMAGES all existing images are removed first. If padding isn't 0 it's reserved before the save, see
+// reserve_padding, so that the audio moves at most once. Returns
+//   u32 size, u32 status, u32 saved, u32 shifts, which is how many times the audio moved, see audio_start
+__attribute__((export_name("taglib_file_apply"))) char *
+taglib_file_apply(const char *filename, const char *tags, const char *images, uint8_t opts, uint32_t padding) {
+  packer p;
+  TagLib::FileRef file(filename);
+  if (file.isNull() || !file.audioProperties()) {
+    p.u32(STATUS_INVALID_FILE);
+    p.u32(0);
+    p.u32(0);
+    return p.finish();
+  }
+
+  const bool changed = apply_mutation(file, tags, images, opts);
+
+  uint32_t shifts = 0;
+  if (changed && padding && reserve_padding(file.file(), padding)) {
+    shifts++;
+    file = TagLib::FileRef(filename);
+    if (file.isNull() || !file.audioProperties()) {
+      p.u32(STATUS_SAVE_FAILED);
+      p.u32(0);
+      p.u32(shifts);
+      return p.finish();
+    }
+    apply_mutation(file, tags, images, opts);
+  }
+
+  const TagLib::offset_t start = audio_start(file.file());
+  const bool saved = changed && file.save();
+  if (saved && audio_start(file.file()) != start)
+    shifts++;
+
+  p.u32(changed && !saved ? STATUS_SAVE_FAILED : STATUS_OK);
+  p.u32(saved);
+  p.u32(shifts);
+  return p.finish();
 }
 
 __attribute__((export_name("taglib_file_clear_images"))) bool
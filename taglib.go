@@ -9,9 +9,11 @@ import (
 	_ "image/jpeg"
 	_ "image/png"
 	"io"
+	"math"
 	"os"
 	"path/filepath"
-	"strings"
+	"runtime"
+	"slices"
 	"sync"
 	"time"
 
@@ -145,36 +147,129 @@ const (
 
 // ReadTags reads all metadata tags from an audio file at the given path.
 func ReadTags(path string) (map[string][]string, error) {
+	return ReadTagsWith(path, ReadOptions{})
+}
+
+// ReadTagsWith reads all metadata tags from an audio file at the given path, like [ReadTags],
+// using what opts says is already known about the file. Values are read in full, whatever opts.MaxValueBytes is.
+func ReadTagsWith(path string, opts ReadOptions) (map[string][]string, error) {
+	opts.MaxValueBytes = 0
+	tags, _, err := ReadTagsTruncated(path, opts)
+	return tags, err
+}
+
+// TruncatedValue is a tag value that was cut short by [ReadOptions.MaxValueBytes].
+type TruncatedValue struct {
+	Key   string
+	Index int // of the value in Key's values
+	Size  int // of the whole value in bytes
+}
+
+// ReadTagsTruncated reads all metadata tags from an audio file at the given path like [ReadTagsWith], and also
+// returns the values that were cut short by opts.MaxValueBytes. Those can be read in full with [ReadTagValue].
+func ReadTagsTruncated(path string, opts ReadOptions) (map[string][]string, []TruncatedValue, error) {
 	var err error
 	path, err = filepath.Abs(path)
 	if err != nil {
-		return nil, fmt.Errorf("make path abs %w", err)
+		return nil, nil, fmt.Errorf("make path abs %w", err)
+	}
+	format := opts.Format
+	if format == FormatUnknown {
+		if format, err = DetectFormat(path); err != nil {
+			return nil, nil, err
+		}
 	}
 
-	dir := filepath.Dir(path)
-	mod, err := newModuleRO(dir)
+	mod, err := newModuleRO(path)
 	if err != nil {
-		return nil, fmt.Errorf("init module: %w", err)
+		return nil, nil, fmt.Errorf("init module: %w", err)
 	}
 	defer mod.close()
 
-	var raw []string
-	if err := mod.call("taglib_file_tags", &raw, wasmPath(path)); err != nil {
-		return nil, fmt.Errorf("call: %w", err)
+	tags, truncated, err := mod.fileTags(wasmPath(path), newHint(format, opts.MPEGTags), opts.MaxValueBytes)
+	if err != nil {
+		return nil, nil, fmt.Errorf("call: %w", err)
 	}
-	if raw == nil {
-		return nil, ErrInvalidFile
+	if tags == nil {
+		return nil, nil, ErrInvalidFile
 	}
+	return tags, truncated, nil
+}
 
-	var tags = map[string][]string{}
-	for _, row := range raw {
-		k, v, ok := strings.Cut(row, "\t")
-		if !ok {
-			continue
+// ReadTagValue reads the value at index of key from an audio file at the given path, in full. opts should be
+// the same as those given to [ReadTagsTruncated], so that the value is read from the same tags. Its
+// MaxValueBytes is ignored.
+func ReadTagValue(path string, key string, index int, opts ReadOptions) (string, error) {
+	var value string
+	var found bool
+	err := withTagsKeys(path, opts, func(mod *module, path string, h hint) (bool, error) {
+		var ok bool
+		var err error
+		value, found, ok, err = mod.fileTagValue(path, key, index, h)
+		return ok, err
+	})
+	if err != nil {
+		return "", err
+	}
+	if !found {
+		return "", fmt.Errorf("no value %d for %q", index, key)
+	}
+	return value, nil
+}
+
+// ReadTagsKeys reads the tags with the given keys from an audio file at the given path. Only those values are
+// copied out of the WASM instance, so long values that aren't needed, like lyrics, cost nothing.
+// Keys that aren't in the file are left out of the result, so with no keys it's empty, once the file has been read.
+func ReadTagsKeys(path string, keys ...string) (map[string][]string, error) {
+	var tags map[string][]string
+	err := withTagsKeys(path, ReadOptions{}, func(mod *module, path string, h hint) (bool, error) {
+		var err error
+		tags, err = mod.fileTagsKeys(path, keys, h)
+		return tags != nil, err
+	})
+	return tags, err
+}
+
+// ReadTagKeyCounts reads the keys of the tags in an audio file at the given path, with the number of values
+// each has, without copying the values themselves. It is meant for surveys of which tags a library uses.
+func ReadTagKeyCounts(path string) (map[string]int, error) {
+	var counts map[string]int
+	err := withTagsKeys(path, ReadOptions{}, func(mod *module, path string, h hint) (bool, error) {
+		var err error
+		counts, err = mod.fileTagKeyCounts(path, h)
+		return counts != nil, err
+	})
+	return counts, err
+}
+
+// withTagsKeys checks out an instance for path and calls read with it, the guest's path for it and a hint from opts
+func withTagsKeys(path string, opts ReadOptions, read func(mod *module, path string, h hint) (bool, error)) error {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return fmt.Errorf("make path abs %w", err)
+	}
+	format := opts.Format
+	if format == FormatUnknown {
+		if format, err = DetectFormat(path); err != nil {
+			return err
 		}
-		tags[k] = append(tags[k], v)
 	}
-	return tags, nil
+
+	mod, err := newModuleRO(path)
+	if err != nil {
+		return fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	ok, err := read(mod, wasmPath(path), newHint(format, opts.MPEGTags))
+	if err != nil {
+		return fmt.Errorf("call: %w", err)
+	}
+	if !ok {
+		return ErrInvalidFile
+	}
+	return nil
 }
 
 // Properties contains the audio properties of a media file.
@@ -189,45 +284,240 @@ type Properties struct {
 	Bitrate uint
 }
 
-// ReadProperties reads the audio properties from a file at the given path.
+// ReadStyle trades the accuracy of audio properties, mostly the length, for speed.
+type ReadStyle uint8
+
+const (
+	// ReadAverage is TagLib's default, a balance of speed and accuracy
+	ReadAverage ReadStyle = iota
+	// ReadFast reads as little of the file as possible, so the length of some files, like VBR MP3s
+	// without a Xing header, is only an estimate
+	ReadFast
+	// ReadAccurate reads as much of the file as needed for exact values
+	ReadAccurate
+)
+
+// ReadProperties reads the audio properties from a file at the given path, with [ReadAverage].
 func ReadProperties(path string) (Properties, error) {
+	return ReadPropertiesWithStyle(path, ReadAverage)
+}
+
+// ReadPropertiesWithStyle reads the audio properties from a file at the given path, as accurately as style asks for.
+func ReadPropertiesWithStyle(path string, style ReadStyle) (Properties, error) {
 	var err error
 	path, err = filepath.Abs(path)
 	if err != nil {
 		return Properties{}, fmt.Errorf("make path abs %w", err)
 	}
+	format, err := DetectFormat(path)
+	if err != nil {
+		return Properties{}, err
+	}
 
-	dir := filepath.Dir(path)
-	mod, err := newModuleRO(dir)
+	mod, err := newModuleRO(path)
 	if err != nil {
 		return Properties{}, fmt.Errorf("init module: %w", err)
 	}
 	defer mod.close()
 
-	const (
-		audioPropertyLengthInMilliseconds = iota
-		audioPropertyChannels
-		audioPropertySampleRate
-		audioPropertyBitrate
-		audioPropertyLen
-	)
-
-	raw := make([]int, 0, audioPropertyLen)
-	if err := mod.call("taglib_file_audioproperties", &raw, wasmPath(path)); err != nil {
+	properties, ok, err := mod.fileAudioProperties(wasmPath(path), style, newHint(format, 0))
+	if err != nil {
 		return Properties{}, fmt.Errorf("call: %w", err)
 	}
+	if !ok {
+		return Properties{}, ErrInvalidFile
+	}
+	return properties, nil
+}
 
-	return Properties{
-		Length:     time.Duration(raw[audioPropertyLengthInMilliseconds]) * time.Millisecond,
-		Channels:   uint(raw[audioPropertyChannels]),
-		SampleRate: uint(raw[audioPropertySampleRate]),
-		Bitrate:    uint(raw[audioPropertyBitrate]),
-	}, nil
+// Result is everything [ReadAll] reads from a file in one parse.
+type Result struct {
+	Tags       map[string][]string
+	Properties Properties
+	Images     []ImageInfo
+	// Format is what [DetectFormat] recognized the file as, so it doesn't need to be detected again
+	Format Format
+
+	// Err is set by batch reads such as [ReadTagsBatch] if this file couldn't be read
+	Err error
+}
+
+// ImageInfo describes an embedded image without its data.
+type ImageInfo struct {
+	// Type is the picture type, such as "Front Cover"
+	Type string
+	// MIMEType of the image data, such as "image/jpeg"
+	MIMEType string
+	// Description is free text set by the tagger, often empty
+	Description string
+	// Size of the image data in bytes
+	Size int
+	// Index of the image in the file, for [ReadImageAt]
+	Index int
+
+	// The rest are only set by [InspectImages] and [FieldImageDetails], from the image data itself
+
+	// Width and Height in pixels, or 0 if they couldn't be read from the header
+	Width, Height int
+	// DetectedMIMEType is the MIME type of the data, which may differ from the tagged MIMEType, or empty if the format
+	// isn't one of JPEG, PNG, GIF or WebP
+	DetectedMIMEType string
+	// Hash is a 64-bit FNV-1a hash of the data, to tell images apart without comparing them
+	Hash uint64
+}
+
+// ReadAll reads the tags, audio properties and image descriptions from a file at the given path.
+// It is cheaper than calling [ReadTags], [ReadProperties] and [ReadImageRaw] separately since the file is only parsed once.
+func ReadAll(path string) (Result, error) {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return Result{}, fmt.Errorf("make path abs %w", err)
+	}
+	format, err := DetectFormat(path)
+	if err != nil {
+		return Result{}, err
+	}
+
+	mod, err := newModuleRO(path)
+	if err != nil {
+		return Result{}, fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	res, ok, err := mod.fileReadAll(wasmPath(path), FieldTags|FieldProperties|FieldImages, ReadAverage, newHint(format, 0))
+	if err != nil {
+		return Result{}, fmt.Errorf("call: %w", err)
+	}
+	if !ok {
+		return Result{}, ErrInvalidFile
+	}
+	res.Format = format
+	return res, nil
+}
+
+// Field selects parts of a file to read, for example in [ScanOptions]. Fields can be combined with the bitwise OR operator.
+type Field uint8
+
+const (
+	// FieldTags reads [Result.Tags]
+	FieldTags Field = 1 << iota
+	// FieldProperties reads [Result.Properties]
+	FieldProperties
+	// FieldImages reads [Result.Images]
+	FieldImages
+	// FieldImageDetails reads [Result.Images] with the details from the image data, see [InspectImages]
+	FieldImageDetails
+)
+
+// batchSize is the number of files read or written per guest call by batch operations. It bounds the guest memory
+// a batch needs, and how often an instance is checked for wear
+const batchSize = 64
+
+// ReadTagsBatch reads all metadata tags from many files. The files in each directory share a WASM instance and are read in groups
+// with a single guest call each, so the per-file overhead is much lower than calling [ReadTags] for each.
+// The results are in the same order as paths, with only [Result.Tags] filled in. A file that can't be read
+// has [Result.Err] set instead of failing the whole batch.
+func ReadTagsBatch(paths []string) ([]Result, error) {
+	results := make([]Result, len(paths))
+	abs := make([]string, len(paths))
+
+	var roots []string
+	var groups = map[string][]int{}
+	for i, path := range paths {
+		var err error
+		abs[i], err = filepath.Abs(path)
+		if err != nil {
+			results[i].Err = fmt.Errorf("make path abs %w", err)
+			continue
+		}
+		if results[i].Format, err = DetectFormat(abs[i]); err != nil {
+			results[i].Err = err
+			continue
+		}
+		root := mountRoot(abs[i])
+		if _, ok := groups[root]; !ok {
+			roots = append(roots, root)
+		}
+		groups[root] = append(groups[root], i)
+	}
+
+	for _, root := range roots {
+		if err := readTagsBatch(root, abs, groups[root], results); err != nil {
+			return nil, err
+		}
+	}
+	return results, nil
 }
 
-// Special type included to record the length of a byte array returned by WASM
-// This needs to be a unique type, otherwise a passed uint32 is ambiguous about whether it is for a byte array or just a regular integer
-type picture []byte
+// readTagsBatch reads the files at indices of paths, which must be absolute and share root
+func readTagsBatch(root string, paths []string, indices []int, results []Result) error {
+	var mod *module
+	defer func() {
+		if mod != nil {
+			mod.close()
+		}
+	}()
+
+	guestPaths := make([]string, 0, batchSize)
+	hints := make([]hint, 0, batchSize)
+
+	// call reads the files at chunk with one guest call, on a fresh instance if the last one trapped or is used up.
+	// A trap is returned as trap, since it only fails the files in chunk
+	call := func(chunk []int) (tags []map[string][]string, trap, err error) {
+		if mod != nil && (mod.broken || mod.worn()) {
+			mod.close()
+			mod = nil
+		}
+		if mod == nil {
+			if mod, err = getModule(poolKey{root: root, readOnly: true}); err != nil {
+				return nil, nil, fmt.Errorf("init module: %w", err)
+			}
+		}
+
+		guestPaths, hints = guestPaths[:0], hints[:0]
+		for _, i := range chunk {
+			guestPaths = append(guestPaths, wasmPath(paths[i]))
+			hints = append(hints, newHint(results[i].Format, 0))
+		}
+		tags, trap = mod.fileTagsBatch(guestPaths, hints)
+		return tags, trap, nil
+	}
+	set := func(i int, tags map[string][]string) {
+		if tags == nil {
+			results[i].Err = ErrInvalidFile
+			return
+		}
+		results[i].Tags = tags
+	}
+
+	for chunk := range slices.Chunk(indices, batchSize) {
+		tags, trap, err := call(chunk)
+		if err != nil {
+			return err
+		}
+		if trap == nil {
+			for j, i := range chunk {
+				set(i, tags[j])
+			}
+			continue
+		}
+
+		// A bad file made the guest trap, so read the chunk again one file at a time to fail only that one
+		for _, i := range chunk {
+			tags, trap, err := call([]int{i})
+			if err != nil {
+				return err
+			}
+			if trap != nil {
+				results[i].Err = fmt.Errorf("call: %w", trap)
+				continue
+			}
+			set(i, tags[0])
+		}
+	}
+	return nil
+}
 
 // ReadImageRaw reads the first available embedded image bytes from path, returning nil if there are no images in the file
 func ReadImageRaw(path string) (io.Reader, error) {
@@ -236,347 +526,1468 @@ func ReadImageRaw(path string) (io.Reader, error) {
 	if err != nil {
 		return nil, fmt.Errorf("make path abs %w", err)
 	}
+	format, err := DetectFormat(path)
+	if err != nil {
+		return nil, err
+	}
+
+	mod, err := newModuleRO(path)
+	if err != nil {
+		return nil, fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	img, err := mod.fileReadImage(wasmPath(path), newHint(format, 0))
+	if err != nil {
+		return nil, fmt.Errorf("call: %w", err)
+	}
+
+	if img == nil {
+		return nil, fmt.Errorf("could not get cover image")
+	}
+
+	return bytes.NewReader(img), nil
+}
+
+// ListImages describes every image embedded in the file at path, without reading their data.
+func ListImages(path string) ([]ImageInfo, error) {
+	return listImages(path, FieldImages)
+}
+
+// InspectImages describes every image embedded in the file at path like [ListImages], and also reads the dimensions
+// and type from their headers and hashes their data. The data is read inside the WASM instance but not copied out.
+func InspectImages(path string) ([]ImageInfo, error) {
+	return listImages(path, FieldImageDetails)
+}
+
+func listImages(path string, fields Field) ([]ImageInfo, error) {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return nil, fmt.Errorf("make path abs %w", err)
+	}
+	format, err := DetectFormat(path)
+	if err != nil {
+		return nil, err
+	}
+
+	mod, err := newModuleRO(path)
+	if err != nil {
+		return nil, fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	res, ok, err := mod.fileReadAll(wasmPath(path), fields, ReadAverage, newHint(format, 0))
+	if err != nil {
+		return nil, fmt.Errorf("call: %w", err)
+	}
+	if !ok {
+		return nil, ErrInvalidFile
+	}
+	return res.Images, nil
+}
+
+// ReadImageAt reads the data of the image at index from the file at path, as listed by [ListImages].
+func ReadImageAt(path string, index int) ([]byte, error) {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return nil, fmt.Errorf("make path abs %w", err)
+	}
+	format, err := DetectFormat(path)
+	if err != nil {
+		return nil, err
+	}
+
+	mod, err := newModuleRO(path)
+	if err != nil {
+		return nil, fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	img, ok, err := mod.fileReadImageAt(wasmPath(path), index, newHint(format, 0))
+	if err != nil {
+		return nil, fmt.Errorf("call: %w", err)
+	}
+	if !ok {
+		return nil, fmt.Errorf("no image at index %d", index)
+	}
+	return img, nil
+}
+
+// ImageSize returns the size in bytes of the image that [ReadImageRaw] reads from path, or 0 if there are no images in the file.
+func ImageSize(path string) (int, error) {
+	var size int
+	err := withImage(path, func(img []byte) error {
+		size = len(img)
+		return nil
+	})
+	return size, err
+}
+
+// ReadImageInto reads the image that [ReadImageRaw] reads from path into dst, copying it straight out of the WASM
+// instance, and returns the number of bytes read. If dst is too small for the image it is filled and [io.ErrShortBuffer]
+// is returned, see [ImageSize]. If there are no images in the file it returns 0.
+func ReadImageInto(path string, dst []byte) (int, error) {
+	var n int
+	var short bool
+	err := withImage(path, func(img []byte) error {
+		n = copy(dst, img)
+		short = n < len(img)
+		return nil
+	})
+	if err != nil {
+		return 0, err
+	}
+	if short {
+		return n, io.ErrShortBuffer
+	}
+	return n, nil
+}
+
+// imageChunkSize is how much of an image [WriteImageTo] writes at a time
+const imageChunkSize = 32 * 1024
+
+// WriteImageTo writes the image that [ReadImageRaw] reads from path to w, returning the number of bytes written.
+// The image is written straight out of the WASM instance in chunks, so no copy of it is made however large it is.
+// If there are no images in the file it writes nothing. The instance stays checked out until w has taken the whole
+// image, so a slow w should be buffered if instances are scarce.
+func WriteImageTo(path string, w io.Writer) (int64, error) {
+	var written int64
+	err := withImage(path, func(img []byte) error {
+		for chunk := range slices.Chunk(img, imageChunkSize) {
+			n, err := w.Write(chunk)
+			written += int64(n)
+			if err != nil {
+				return err
+			}
+		}
+		return nil
+	})
+	return written, err
+}
+
+// withImage calls fn with a view of the data of the image that [ReadImageRaw] reads from path, which is only
+// valid during the call. Errors from fn are returned as they are
+func withImage(path string, fn func(img []byte) error) error {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return fmt.Errorf("make path abs %w", err)
+	}
+	format, err := DetectFormat(path)
+	if err != nil {
+		return err
+	}
+
+	mod, err := newModuleRO(path)
+	if err != nil {
+		return fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	img, err := mod.fileImage(wasmPath(path), newHint(format, 0))
+	if err != nil {
+		return fmt.Errorf("call: %w", err)
+	}
+	return fn(img)
+}
+
+// ReadTagsBytes reads all metadata tags from the contents of an audio file. The contents are copied into the
+// WASM instance and parsed there, without a temporary file.
+func ReadTagsBytes(b []byte) (map[string][]string, error) {
+	format, err := detectFormatBytes(b)
+	if err != nil {
+		return nil, err
+	}
+	mod, err := newModuleMem()
+	if err != nil {
+		return nil, fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	tags, err := mod.bytesTags(b, newHint(format, 0))
+	if err != nil {
+		return nil, fmt.Errorf("call: %w", err)
+	}
+	if tags == nil {
+		return nil, ErrInvalidFile
+	}
+	return tags, nil
+}
+
+// ReadPropertiesBytes reads the audio properties from the contents of an audio file, like [ReadTagsBytes].
+func ReadPropertiesBytes(b []byte) (Properties, error) {
+	format, err := detectFormatBytes(b)
+	if err != nil {
+		return Properties{}, err
+	}
+	mod, err := newModuleMem()
+	if err != nil {
+		return Properties{}, fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	properties, ok, err := mod.bytesAudioProperties(b, newHint(format, 0))
+	if err != nil {
+		return Properties{}, fmt.Errorf("call: %w", err)
+	}
+	if !ok {
+		return Properties{}, ErrInvalidFile
+	}
+	return properties, nil
+}
 
-	mod, err := newModuleRO(filepath.Dir(path))
+// ReadImageBytes reads the first available embedded image bytes from the contents of an audio file, like [ReadTagsBytes].
+func ReadImageBytes(b []byte) (io.Reader, error) {
+	format, err := detectFormatBytes(b)
+	if err != nil {
+		return nil, err
+	}
+	mod, err := newModuleMem()
 	if err != nil {
 		return nil, fmt.Errorf("init module: %w", err)
 	}
 	defer mod.close()
 
-	var img picture
-	if err := mod.call("taglib_file_read_image", &img, wasmPath(path)); err != nil {
-		return nil, fmt.Errorf("call: %w", err)
+	img, err := mod.bytesReadImage(b, newHint(format, 0))
+	if err != nil {
+		return nil, fmt.Errorf("call: %w", err)
+	}
+	if img == nil {
+		return nil, fmt.Errorf("could not get cover image")
+	}
+	return bytes.NewReader(img), nil
+}
+
+// ReadImage reads the first available embedded image from path, returning nil if there are no images in the file
+func ReadImage(path string) (image.Image, error) {
+	r, err := ReadImageRaw(path)
+	if err != nil {
+		return nil, fmt.Errorf("getting image bytes: %w", err)
+	}
+
+	img, _, err := image.Decode(r)
+	if err != nil {
+		return nil, fmt.Errorf("decoding image: %w", err)
+	}
+	return img, nil
+}
+
+// WriteImage writes the image at img to path
+func WriteImage(path, img string) error {
+	img, err := filepath.Abs(img)
+	if err != nil {
+		return fmt.Errorf("make image path abs %w", err)
+	}
+
+	imgData, err := os.ReadFile(img)
+	if err != nil {
+		return fmt.Errorf("reading image file: %w", err)
+	}
+
+	return WriteImageRaw(path, imgData)
+}
+
+func WriteImageRaw(path string, image []byte) error {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return fmt.Errorf("make path abs %w", err)
+	}
+
+	mod, err := newModule(path)
+	if err != nil {
+		return fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	out, err := mod.fileWriteImage(wasmPath(path), image)
+	if err != nil {
+		return fmt.Errorf("call: %w", err)
+	}
+	if !out {
+		return ErrSavingFile
+	}
+	return nil
+}
+
+// ImageOptions describes an image written by [WriteImageMany] or [Apply]. Empty fields take the defaults of [WriteImageRaw].
+type ImageOptions struct {
+	// Type is the picture type as TagLib names it, like "Front Cover", which is the default, or "Back Cover"
+	Type string
+	// MIMEType is detected as PNG or JPEG from the data by default
+	MIMEType string
+	// Description defaults to "Added by go-taglib"
+	Description string
+}
+
+// WriteImageMany replaces the images of every file in paths with img, like [WriteImageRaw] does for one. The files
+// in each directory share a WASM instance, and img is copied into it once per batch of files rather than once per
+// file. The errors are in the same order as paths, nil for files that were written. A file that can't be written,
+// even one that makes the guest trap, doesn't stop the others.
+func WriteImageMany(paths []string, img []byte, opts ImageOptions) ([]error, error) {
+	errs := make([]error, len(paths))
+	abs := make([]string, len(paths))
+
+	var roots []string
+	var groups = map[string][]int{}
+	for i, path := range paths {
+		var err error
+		abs[i], err = filepath.Abs(path)
+		if err != nil {
+			errs[i] = fmt.Errorf("make path abs %w", err)
+			continue
+		}
+		root := mountRoot(abs[i])
+		if _, ok := groups[root]; !ok {
+			roots = append(roots, root)
+		}
+		groups[root] = append(groups[root], i)
+	}
+
+	for _, root := range roots {
+		if err := writeImageMany(root, abs, groups[root], img, opts, errs); err != nil {
+			return nil, err
+		}
+	}
+	return errs, nil
+}
+
+// writeImageMany writes the files at indices of paths, which must be absolute and share root
+func writeImageMany(root string, paths []string, indices []int, img []byte, opts ImageOptions, errs []error) error {
+	var mod *module
+	defer func() {
+		if mod != nil {
+			mod.close()
+		}
+	}()
+
+	guestPaths := make([]string, 0, batchSize)
+
+	// call writes the files at chunk with one guest call, on a fresh instance if the last one trapped or is used up.
+	// A trap is returned as trap, since it only fails the files in chunk
+	call := func(chunk []int) (statuses []uint32, trap, err error) {
+		if mod != nil && (mod.broken || mod.worn()) {
+			mod.close()
+			mod = nil
+		}
+		if mod == nil {
+			if mod, err = getModule(poolKey{root: root}); err != nil {
+				return nil, nil, fmt.Errorf("init module: %w", err)
+			}
+		}
+
+		guestPaths = guestPaths[:0]
+		for _, i := range chunk {
+			guestPaths = append(guestPaths, wasmPath(paths[i]))
+		}
+		statuses, trap = mod.fileWriteImageMany(guestPaths, img, opts)
+		return statuses, trap, nil
+	}
+	set := func(i int, status uint32) {
+		switch status {
+		case statusOK:
+		case statusInvalidFile:
+			errs[i] = ErrInvalidFile
+		default:
+			errs[i] = ErrSavingFile
+		}
+	}
+
+	for chunk := range slices.Chunk(indices, batchSize) {
+		statuses, trap, err := call(chunk)
+		if err != nil {
+			return err
+		}
+		if trap == nil {
+			for j, i := range chunk {
+				set(i, statuses[j])
+			}
+			continue
+		}
+
+		// A bad file made the guest trap, so write the chunk again one file at a time to fail only that one. The
+		// files before it may have been written already, which writing them again doesn't change
+		for _, i := range chunk {
+			statuses, trap, err := call([]int{i})
+			if err != nil {
+				return err
+			}
+			if trap != nil {
+				errs[i] = fmt.Errorf("call: %w", trap)
+				continue
+			}
+			set(i, statuses[0])
+		}
+	}
+	return nil
+}
+
+// Image is an image to write with [Apply].
+type Image struct {
+	Data []byte
+	ImageOptions
+}
+
+// Mutation is a set of changes to a file that [Apply] saves together.
+type Mutation struct {
+	// Tags sets the values of each key. Keys with no values, or a single empty value, are removed
+	Tags map[string][]string
+	// ClearTags removes the existing tags that aren't in Tags, like [Clear]
+	ClearTags bool
+	// Images are added, each replacing the existing images of its type
+	Images []Image
+	// ClearImages removes all existing images before Images are added
+	ClearImages bool
+	// Padding is the number of bytes of padding to keep after the tags of FLAC files and MPEG files with ID3v2,
+	// so that later edits fit in place instead of moving the audio. When the save would leave less than half of
+	// it, the padding is grown to Padding before saving, so the audio moves once, and the save itself fits in
+	// place. TagLib itself cuts padding over 1% of the file, or 1 MiB, back to its minimum, so Padding is capped
+	// to that. Zero leaves the padding to TagLib
+	Padding int
+}
+
+// WriteResult is what a write did to the file.
+type WriteResult struct {
+	// Saved is false if the changes left the file as it was, so it wasn't written at all
+	Saved bool
+	// InPlace is true if the file was saved without moving the audio, so only the tags were rewritten rather
+	// than everything after them
+	InPlace bool
+	// Shifts is the number of times the audio moved, which is at most 1 unless TagLib needed more room than
+	// [Mutation.Padding] accounted for. For formats other than FLAC and MPEG it's whether the length changed
+	Shifts int
+}
+
+// Apply makes all the changes in m to the file at path and saves it once, so that changing both tags and images
+// rewrites the file at most once, where [WriteTags] followed by [WriteImageRaw] could rewrite it twice.
+func Apply(path string, m Mutation) (WriteResult, error) {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return WriteResult{}, fmt.Errorf("make path abs %w", err)
+	}
+
+	mod, err := newModule(path)
+	if err != nil {
+		return WriteResult{}, fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	res, status, err := mod.fileApply(wasmPath(path), m)
+	if err != nil {
+		return WriteResult{}, fmt.Errorf("call: %w", err)
+	}
+	switch status {
+	case statusOK:
+		return res, nil
+	case statusInvalidFile:
+		return WriteResult{}, ErrInvalidFile
+	default:
+		return WriteResult{}, ErrSavingFile
+	}
+}
+
+// ClearImages removes all images from the file at path
+func ClearImages(path string) error {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return fmt.Errorf("make path abs %w", err)
+	}
+
+	mod, err := newModule(path)
+	if err != nil {
+		return fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	out, err := mod.fileClearImages(wasmPath(path))
+	if err != nil {
+		return fmt.Errorf("call: %w", err)
+	}
+	if !out {
+		return ErrSavingFile
+	}
+	return nil
+}
+
+// WriteOption configures the behavior of write operations. The can be passed to [WriteTags] and combined with the bitwise OR operator.
+type WriteOption uint8
+
+const (
+	// Clear indicates that all existing tags not present in the new map should be removed.
+	Clear WriteOption = 1 << iota
+
+	// DiffBeforeWrite enables comparison before writing to disk.
+	// When set, no write occurs if the map contains no changes compared to the existing tags.
+	DiffBeforeWrite
+)
+
+// WriteTags writes the metadata key-values pairs to path. The behavior can be controlled with [WriteOption].
+// Keys with no values, or with a single empty value, are removed.
+func WriteTags(path string, tags map[string][]string, opts WriteOption) error {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return fmt.Errorf("make path abs %w", err)
+	}
+
+	mod, err := newModule(path)
+	if err != nil {
+		return fmt.Errorf("init module: %w", err)
+	}
+	defer mod.close()
+
+	out, err := mod.fileWriteTags(wasmPath(path), tags, opts)
+	if err != nil {
+		return fmt.Errorf("call: %w", err)
+	}
+	if !out {
+		return ErrSavingFile
+	}
+	return nil
+}
+
+// File is an audio file opened with [Open]. It stays parsed between calls, so reading tags, properties and
+// images costs one parse instead of one each. A File holds on to its own WASM instance, a few megabytes of
+// memory, until [File.Close] is called. Open files aren't limited by the instance pool, so any number can be open
+// at once without holding up other calls, but each one costs that memory. A File is not safe for concurrent use.
+type File struct {
+	mod    *module
+	handle uint32
+}
+
+// Open opens and parses the audio file at path.
+func Open(path string) (*File, error) {
+	var err error
+	path, err = filepath.Abs(path)
+	if err != nil {
+		return nil, fmt.Errorf("make path abs %w", err)
+	}
+	format, err := DetectFormat(path)
+	if err != nil {
+		return nil, err
+	}
+
+	mod, err := checkout(poolKey{root: mountRoot(path)}, false)
+	if err != nil {
+		return nil, fmt.Errorf("init module: %w", err)
+	}
+
+	handle, err := mod.open(wasmPath(path), newHint(format, 0))
+	if err != nil {
+		mod.close()
+		return nil, fmt.Errorf("call: %w", err)
+	}
+	if handle == 0 {
+		mod.close()
+		return nil, ErrInvalidFile
+	}
+
+	return &File{mod: mod, handle: handle}, nil
+}
+
+// Tags reads all metadata tags from the file, including changes from [File.SetTags] that are not saved yet.
+func (f *File) Tags() (map[string][]string, error) {
+	tags, err := f.mod.handleTags(f.handle)
+	if err != nil {
+		return nil, fmt.Errorf("call: %w", err)
+	}
+	if tags == nil {
+		return nil, ErrInvalidFile
+	}
+	return tags, nil
+}
+
+// Properties reads the audio properties of the file.
+func (f *File) Properties() (Properties, error) {
+	properties, ok, err := f.mod.handleAudioProperties(f.handle)
+	if err != nil {
+		return Properties{}, fmt.Errorf("call: %w", err)
+	}
+	if !ok {
+		return Properties{}, ErrInvalidFile
+	}
+	return properties, nil
+}
+
+// Image reads the first available embedded image bytes, like [ReadImageRaw].
+func (f *File) Image() (io.Reader, error) {
+	img, err := f.mod.handleReadImage(f.handle)
+	if err != nil {
+		return nil, fmt.Errorf("call: %w", err)
+	}
+	if img == nil {
+		return nil, fmt.Errorf("could not get cover image")
+	}
+	return bytes.NewReader(img), nil
+}
+
+// SetTags updates the tags of the file in the same way as [WriteTags], but nothing is written until [File.Save].
+func (f *File) SetTags(tags map[string][]string, opts WriteOption) error {
+	out, err := f.mod.handleSetTags(f.handle, tags, opts)
+	if err != nil {
+		return fmt.Errorf("call: %w", err)
+	}
+	if !out {
+		return ErrInvalidFile
+	}
+	return nil
+}
+
+// Save writes changes made with [File.SetTags] to disk. It does nothing if there are none.
+func (f *File) Save() error {
+	out, err := f.mod.handleSave(f.handle)
+	if err != nil {
+		return fmt.Errorf("call: %w", err)
+	}
+	if !out {
+		return ErrSavingFile
+	}
+	return nil
+}
+
+// Close releases the file without saving it. The File must not be used after.
+func (f *File) Close() error {
+	if f.mod == nil {
+		return nil
+	}
+	defer func() { f.mod = nil }()
+	defer f.mod.close()
+
+	if err := f.mod.closeHandle(f.handle); err != nil {
+		return fmt.Errorf("call: %w", err)
+	}
+	return nil
+}
+
+type rc struct {
+	wazero.Runtime
+	wazero.CompiledModule
+}
+
+var getRuntimeOnce = sync.OnceValues(func() (rc, error) {
+	ctx := context.Background()
+
+	cacheDir := filepath.Join(os.TempDir(), "go-taglib-wasm")
+	compilationCache, err := wazero.NewCompilationCacheWithDir(cacheDir)
+	if err != nil {
+		return rc{}, err
+	}
+
+	rt := wazero.NewRuntimeWithConfig(ctx,
+		wazero.NewRuntimeConfig().
+			WithCompilationCache(compilationCache),
+	)
+	wasi_snapshot_preview1.MustInstantiate(ctx, rt)
+
+	env := rt.
+		NewHostModuleBuilder("env").
+		NewFunctionBuilder().WithFunc(func(int32) int32 { panic("__cxa_allocate_exception") }).Export("__cxa_allocate_exception").
+		NewFunctionBuilder().WithFunc(func(int32, int32, int32) { panic("__cxa_throw") }).Export("__cxa_throw")
+	_, err = exportStreamFuncs(env).Instantiate(ctx)
+	if err != nil {
+		return rc{}, err
+	}
+
+	var bin = binary
+	if binaryPath != "" {
+		bin, err = os.ReadFile(binaryPath)
+		if err != nil {
+			return rc{}, fmt.Errorf("read custom binary path: %w", err)
+		}
+		clear(binary)
+	}
+
+	compiled, err := rt.CompileModule(ctx, bin)
+	if err != nil {
+		return rc{}, err
+	}
+	for _, name := range exportNames {
+		if _, ok := compiled.ExportedFunctions()[name]; !ok {
+			return rc{}, fmt.Errorf("binary is missing export %q", name)
+		}
+	}
+
+	return rc{
+		Runtime:        rt,
+		CompiledModule: compiled,
+	}, nil
+})
+
+// Instances are pooled rather than created per call, since instantiating and running _initialize
+// costs more than most reads. Each instance mounts only the directory of the file it was checked out for, like
+// a one-off instance would, and an idle one is reused for the next file in the same directory.
+var poolSize = runtime.GOMAXPROCS(0)
+
+var (
+	// moduleMaxUses is the number of guest calls after which an instance is discarded instead of reused
+	moduleMaxUses = 10_000
+	// moduleMaxMemory is the guest memory size after which a pooled instance is discarded. WASM memory never shrinks
+	moduleMaxMemory uint32 = 64 << 20
+)
+
+// poolKey is what an instance has mounted. An empty root mounts nothing, for reading files from memory
+type poolKey struct {
+	root     string
+	readOnly bool
+}
+
+// pool bounds the number of live instances with sem, and keeps up to poolSize idle ones, least recently used first,
+// so that a walk over many directories doesn't leave instances behind in each
+var pool = struct {
+	sem  chan struct{}
+	mu   sync.Mutex
+	idle []*module
+}{sem: make(chan struct{}, poolSize)}
+
+func getModule(key poolKey) (*module, error) {
+	return checkout(key, true)
+}
+
+// checkout takes an idle instance for key or makes one. Unless counted, it doesn't wait for or take a slot of
+// pool.sem, for instances that are held for as long as the caller likes, see [Open]
+func checkout(key poolKey, counted bool) (*module, error) {
+	if counted {
+		pool.sem <- struct{}{}
+	}
+
+	pool.mu.Lock()
+	for i := len(pool.idle) - 1; i >= 0; i-- {
+		if m := pool.idle[i]; m.key == key {
+			pool.idle = slices.Delete(pool.idle, i, i+1)
+			pool.mu.Unlock()
+			m.counted = counted
+			return m, nil
+		}
+	}
+	pool.mu.Unlock()
+
+	fsConfig := wazero.NewFSConfig()
+	switch {
+	case key.root == "":
+	case key.readOnly:
+		fsConfig = fsConfig.WithReadOnlyDirMount(key.root, wasmPath(key.root))
+	default:
+		fsConfig = fsConfig.WithDirMount(key.root, wasmPath(key.root))
+	}
+	m, err := instantiate(fsConfig)
+	if err != nil {
+		if counted {
+			<-pool.sem
+		}
+		return nil, err
+	}
+	m.key, m.counted = key, counted
+	return m, nil
+}
+
+func putModule(m *module) {
+	if m.broken || m.worn() {
+		closeInstance(m)
+	} else {
+		pool.mu.Lock()
+		pool.idle = append(pool.idle, m)
+		var evicted *module
+		if len(pool.idle) > poolSize {
+			evicted = pool.idle[0]
+			pool.idle = slices.Delete(pool.idle, 0, 1)
+		}
+		pool.mu.Unlock()
+		if evicted != nil {
+			closeInstance(evicted)
+		}
+	}
+	if m.counted {
+		<-pool.sem
+	}
+}
+
+func closeInstance(m *module) {
+	if err := m.mod.Close(context.Background()); err != nil {
+		panic(err)
+	}
+}
+
+type module struct {
+	mod api.Module
+	fns [exportCount]api.Function
+	key poolKey
+	ctx context.Context // carries the module to host functions, see [streamOf]
+
+	stream *hostStream // bound for calls that read through a host stream
+
+	stack    []uint64 // params and results, reused between calls
+	args     []byte   // staged arguments for the next call, see [module.flush]
+	blobs    []blob
+	argsSize uint32
+
+	uses    int  // guest calls made, see [moduleMaxUses]
+	counted bool // holds a slot of pool.sem
+	broken  bool // set after a guest trap, the instance state can't be trusted
+}
+
+// blob is a staged byte argument. It's written straight from the caller's slice rather than copied into args
+type blob struct {
+	at int // position in args it comes before
+	b  []byte
+}
+
+// newModuleMem checks out an instance with no filesystem access, for reading from memory or host streams.
+// It must be returned with [module.close]
+func newModuleMem() (*module, error) {
+	return getModule(poolKey{readOnly: true})
+}
+
+// newModule checks out an instance that can access path. It must be returned with [module.close]
+func newModule(path string) (*module, error)   { return newModuleOpt(path, false) }
+func newModuleRO(path string) (*module, error) { return newModuleOpt(path, true) }
+func newModuleOpt(path string, readOnly bool) (*module, error) {
+	return getModule(poolKey{root: mountRoot(path), readOnly: readOnly})
+}
+
+func instantiate(fsConfig wazero.FSConfig) (*module, error) {
+	rt, err := getRuntimeOnce()
+	if err != nil {
+		return nil, fmt.Errorf("get runtime once: %w", err)
+	}
+
+	cfg := wazero.
+		NewModuleConfig().
+		WithName("").
+		WithStartFunctions("_initialize").
+		WithFSConfig(fsConfig)
+
+	ctx := context.Background()
+	mod, err := rt.Runtime.InstantiateModule(ctx, rt.CompiledModule, cfg)
+	if err != nil {
+		return nil, err
+	}
+
+	m := &module{
+		mod:   mod,
+		stack: make([]uint64, 0, 8),
+	}
+	m.ctx = context.WithValue(context.Background(), moduleKey{}, m)
+	for i, name := range exportNames {
+		m.fns[i] = mod.ExportedFunction(name)
+	}
+	return m, nil
+}
+
+// export is an exported guest function. They are resolved once per instance, rather than looked up by name per call
+type export uint8
+
+const (
+	exportReset export = iota
+	exportFileTags
+	exportFileWriteTags
+	exportFileAudioProperties
+	exportFileReadImage
+	exportFileReadImageAt
+	exportFileWriteImage
+	exportFileWriteImageMany
+	exportFileClearImages
+	exportFileApply
+	exportFileReadAll
+	exportFileTagsBatch
+	exportFileTagsKeys
+	exportFileTagValue
+	exportBytesTags
+	exportBytesAudioProperties
+	exportBytesReadImage
+	exportStreamTags
+	exportStreamWriteTags
+	exportOpen
+	exportClose
+	exportHandleTags
+	exportHandleAudioProperties
+	exportHandleReadImage
+	exportHandleSetTags
+	exportHandleSave
+	exportCount
+)
+
+var exportNames = [exportCount]string{
+	exportReset:                 "taglib_reset",
+	exportFileTags:              "taglib_file_tags",
+	exportFileWriteTags:         "taglib_file_write_tags",
+	exportFileAudioProperties:   "taglib_file_audioproperties",
+	exportFileReadImage:         "taglib_file_read_image",
+	exportFileReadImageAt:       "taglib_file_read_image_at",
+	exportFileWriteImage:        "taglib_file_write_image",
+	exportFileWriteImageMany:    "taglib_file_write_image_many",
+	exportFileClearImages:       "taglib_file_clear_images",
+	exportFileApply:             "taglib_file_apply",
+	exportFileReadAll:           "taglib_file_read_all",
+	exportFileTagsBatch:         "taglib_file_tags_batch",
+	exportFileTagsKeys:          "taglib_file_tags_keys",
+	exportFileTagValue:          "taglib_file_tag_value",
+	exportBytesTags:             "taglib_bytes_tags",
+	exportBytesAudioProperties:  "taglib_bytes_audioproperties",
+	exportBytesReadImage:        "taglib_bytes_read_image",
+	exportStreamTags:            "taglib_stream_tags",
+	exportStreamWriteTags:       "taglib_stream_write_tags",
+	exportOpen:                  "taglib_open",
+	exportClose:                 "taglib_close",
+	exportHandleTags:            "taglib_handle_tags",
+	exportHandleAudioProperties: "taglib_handle_audioproperties",
+	exportHandleReadImage:       "taglib_handle_read_image",
+	exportHandleSetTags:         "taglib_handle_set_tags",
+	exportHandleSave:            "taglib_handle_save",
+}
+
+// call calls fn and returns its first result, or 0 if it has none. Arguments that point to memory must be
+// staged and flushed first, see [module.flush]
+func (m *module) call(fn export, params ...uint64) (uint64, error) {
+	m.uses++
+	m.stack = append(m.stack[:0], params...)
+	if len(m.stack) == 0 {
+		m.stack = append(m.stack, 0)
+	}
+	if err := m.fns[fn].CallWithStack(m.ctx, m.stack); err != nil {
+		m.broken = true
+		return 0, fmt.Errorf("call %q: %w", exportNames[fn], err)
+	}
+	return m.stack[0], nil
+}
+
+// stageString stages s as a NUL terminated argument, returning its offset from the base that [module.flush] returns
+func (m *module) stageString(s string) uint32 {
+	off := m.argsSize
+	m.args = append(m.args, s...)
+	m.args = append(m.args, 0)
+	m.argsSize += uint32(len(s)) + 1
+	return off
+}
+
+// stageBytes stages b as an argument, returning its offset from the base that [module.flush] returns
+func (m *module) stageBytes(b []byte) uint32 {
+	off := m.argsSize
+	m.blobs = append(m.blobs, blob{at: len(m.args), b: b})
+	m.argsSize += uint32(len(b))
+	return off
+}
+
+// stageTags stages tags in the packed format that packer in taglib.cpp produces, returning its offset
+func (m *module) stageTags(tags map[string][]string) uint32 {
+	off := m.argsSize
+	start := len(m.args)
+
+	var values int
+	for _, vs := range tags {
+		values += len(vs)
+	}
+	m.args = appendUint32(m.args, 0) // size, filled in below
+	m.args = appendUint32(m.args, uint32(len(tags)))
+	m.args = appendUint32(m.args, uint32(values))
+	for k, vs := range tags {
+		m.args = appendUint32(m.args, uint32(len(k)))
+		m.args = append(m.args, k...)
+		m.args = appendUint32(m.args, uint32(len(vs)))
+		for _, v := range vs {
+			m.args = appendUint32(m.args, uint32(len(v)))
+			m.args = append(m.args, v...)
+		}
+	}
+
+	size := len(m.args) - start
+	putUint32(m.args[start:], uint32(size))
+	m.argsSize += uint32(size)
+	return off
+}
+
+// stageStrings stages ss as a packed list of strings, returning its offset
+//
+//	u32 size, u32 count, then per string: u32 length, bytes
+func (m *module) stageStrings(ss []string) uint32 {
+	off := m.argsSize
+	start := len(m.args)
+
+	m.args = appendUint32(m.args, 0) // size, filled in below
+	m.args = appendUint32(m.args, uint32(len(ss)))
+	for _, s := range ss {
+		m.args = appendUint32(m.args, uint32(len(s)))
+		m.args = append(m.args, s...)
+	}
+
+	size := len(m.args) - start
+	putUint32(m.args[start:], uint32(size))
+	m.argsSize += uint32(size)
+	return off
+}
+
+// stageImages stages images in the packed format that taglib_file_apply reads, returning its offset. The image
+// data is staged like [module.stageBytes], so it isn't copied on the host
+//
+//	u32 size, u32 count, then per image: str type, str MIME type, str description, str data
+func (m *module) stageImages(images []Image) uint32 {
+	off := m.argsSize
+	start := len(m.args)
+
+	var data int
+	m.args = appendUint32(m.args, 0) // size, filled in below
+	m.args = appendUint32(m.args, uint32(len(images)))
+	for _, img := range images {
+		for _, s := range []string{img.Type, img.MIMEType, img.Description} {
+			m.args = appendUint32(m.args, uint32(len(s)))
+			m.args = append(m.args, s...)
+		}
+		m.args = appendUint32(m.args, uint32(len(img.Data)))
+		m.blobs = append(m.blobs, blob{at: len(m.args), b: img.Data})
+		data += len(img.Data)
+	}
+
+	size := len(m.args) - start + data
+	putUint32(m.args[start:], uint32(size))
+	m.argsSize += uint32(size)
+	return off
+}
+
+// flush rewinds the guest's arena and copies the staged arguments into a single allocation, returning its address.
+// Results of previous calls are invalid after
+func (m *module) flush() (uint32, error) {
+	defer m.clearArgs()
+
+	base, err := m.call(exportReset, uint64(m.argsSize))
+	if err != nil {
+		return 0, err
+	}
+	if m.argsSize == 0 {
+		return 0, nil
+	}
+	if base == 0 {
+		return 0, fmt.Errorf("can't allocate %d bytes of arguments", m.argsSize)
+	}
+
+	mem := m.mod.Memory()
+	at, pos := uint32(base), 0
+	for _, bl := range m.blobs {
+		if !mem.Write(at, m.args[pos:bl.at]) || !mem.Write(at+uint32(bl.at-pos), bl.b) {
+			panic("failed to write to mod.module.Memory()")
+		}
+		at += uint32(bl.at-pos) + uint32(len(bl.b))
+		pos = bl.at
+	}
+	if !mem.Write(at, m.args[pos:]) {
+		panic("failed to write to mod.module.Memory()")
+	}
+	return uint32(base), nil
+}
+
+func (m *module) clearArgs() {
+	clear(m.blobs) // don't keep the caller's slices alive
+	m.args, m.blobs, m.argsSize = m.args[:0], m.blobs[:0], 0
+}
+
+// callPath calls fn with a path argument followed by params
+func (m *module) callPath(fn export, path string, params ...uint64) (uint64, error) {
+	pathArg := m.stageString(path)
+	base, err := m.flush()
+	if err != nil {
+		return 0, err
+	}
+	switch len(params) {
+	case 0:
+		return m.call(fn, uint64(base+pathArg))
+	case 1:
+		return m.call(fn, uint64(base+pathArg), params[0])
+	default:
+		return m.call(fn, append([]uint64{uint64(base + pathArg)}, params...)...)
+	}
+}
+
+// callBytes calls fn with b as a pointer and length
+func (m *module) callBytes(fn export, b []byte, params ...uint64) (uint64, error) {
+	bArg := m.stageBytes(b)
+	base, err := m.flush()
+	if err != nil {
+		return 0, err
+	}
+	return m.call(fn, append([]uint64{uint64(base + bArg), uint64(len(b))}, params...)...)
+}
+
+// callHandle calls fn with a handle from [module.open]
+func (m *module) callHandle(fn export, handle uint32) (uint64, error) {
+	if _, err := m.flush(); err != nil {
+		return 0, err
 	}
+	return m.call(fn, uint64(handle))
+}
 
-	if img == nil {
-		return nil, fmt.Errorf("could not get cover image")
+// Typed stubs for the exports. A nil or false result with no error means the guest couldn't read or save the file
+
+// fileTags reads tags with values cut to maxValue bytes, if it's positive, also returning the values that were cut
+func (m *module) fileTags(path string, h hint, maxValue int) (map[string][]string, []TruncatedValue, error) {
+	maxValue = min(max(maxValue, 0), math.MaxInt32)
+	ptr, err := m.callPath(exportFileTags, path, uint64(h), uint64(maxValue))
+	if err != nil || ptr == 0 {
+		return nil, nil, err
+	}
+	if maxValue == 0 {
+		return readTags(m, uint32(ptr)), nil, nil
 	}
 
-	return bytes.NewReader(img), nil
+	d := decoder{s: string(readPacked(m, uint32(ptr)))}
+	tags, truncated := d.tags(), d.truncated()
+	if tags == nil || !d.ok() {
+		panic("malformed tag buffer")
+	}
+	return tags, truncated, nil
 }
 
-// ReadImage reads the first available embedded image from path, returning nil if there are no images in the file
-func ReadImage(path string) (image.Image, error) {
-	r, err := ReadImageRaw(path)
+// fileTagValue reads one value. found is false if there's no such value, and ok is false if the file is invalid
+func (m *module) fileTagValue(path, key string, index int, h hint) (value string, found, ok bool, err error) {
+	if index < 0 || index > math.MaxInt32 {
+		return "", false, true, nil
+	}
+	pathArg := m.stageString(path)
+	keyArg := m.stageString(key)
+	base, err := m.flush()
 	if err != nil {
-		return nil, fmt.Errorf("getting image bytes: %w", err)
+		return "", false, false, err
+	}
+	ptr, err := m.call(exportFileTagValue, uint64(base+pathArg), uint64(base+keyArg), uint64(index), uint64(h))
+	if err != nil || ptr == 0 {
+		return "", false, false, err
 	}
 
-	img, _, err := image.Decode(r)
-	if err != nil {
-		return nil, fmt.Errorf("decoding image: %w", err)
+	d := decoder{s: string(readPacked(m, uint32(ptr)))}
+	if d.u32() == 0 {
+		return "", false, true, nil
 	}
-	return img, nil
+	value = d.str()
+	if !d.ok() {
+		panic("malformed tag buffer")
+	}
+	return value, true, true, nil
 }
 
-// WriteImage writes the image at img to path
-func WriteImage(path, img string) error {
-	img, err := filepath.Abs(img)
+func (m *module) fileWriteTags(path string, tags map[string][]string, opts WriteOption) (bool, error) {
+	pathArg := m.stageString(path)
+	tagsArg := m.stageTags(tags)
+	base, err := m.flush()
 	if err != nil {
-		return fmt.Errorf("make image path abs %w", err)
+		return false, err
 	}
+	out, err := m.call(exportFileWriteTags, uint64(base+pathArg), uint64(base+tagsArg), uint64(opts))
+	return out == 1, err
+}
 
-	imgData, err := os.ReadFile(img)
-	if err != nil {
-		return fmt.Errorf("reading image file: %w", err)
+func (m *module) fileAudioProperties(path string, style ReadStyle, h hint) (Properties, bool, error) {
+	ptr, err := m.callPath(exportFileAudioProperties, path, uint64(style), uint64(h))
+	if err != nil || ptr == 0 {
+		return Properties{}, false, err
 	}
+	return readProperties(m, uint32(ptr)), true, nil
+}
 
-	return WriteImageRaw(path, imgData)
+func (m *module) fileReadImage(path string, h hint) ([]byte, error) {
+	img, err := m.fileImage(path, h)
+	return bytes.Clone(img), err
 }
 
-func WriteImageRaw(path string, image []byte) error {
-	var err error
-	path, err = filepath.Abs(path)
-	if err != nil {
-		return fmt.Errorf("make path abs %w", err)
+// fileReadImageAt copies the image at index. ok is false if there's no such image or the file is invalid
+func (m *module) fileReadImageAt(path string, index int, h hint) ([]byte, bool, error) {
+	if index < 0 || index > math.MaxInt32 {
+		return nil, false, nil
+	}
+	ptr, err := m.callPath(exportFileReadImageAt, path, uint64(index), uint64(h))
+	if err != nil || ptr == 0 {
+		return nil, false, err
 	}
+	return readPicture(m, uint32(ptr)), true, nil
+}
 
-	mod, err := newModule(filepath.Dir(path))
-	if err != nil {
-		return fmt.Errorf("init module: %w", err)
+// fileImage returns a view of the image's data in guest memory, valid until the next call
+func (m *module) fileImage(path string, h hint) ([]byte, error) {
+	ptr, err := m.callPath(exportFileReadImage, path, uint64(h), 0)
+	if err != nil || ptr == 0 {
+		return nil, err
 	}
-	defer mod.close()
+	return pictureView(m, uint32(ptr)), nil
+}
 
-	var out bool
-	if err := mod.call("taglib_file_write_image", &out, wasmPath(path), image, len(image)); err != nil {
-		return fmt.Errorf("call: %w", err)
+// Options of taglib_file_read_image, see taglib.cpp
+const imageHash = 1 << 0
+
+// fileImageHash is fileImage that also returns the hash of the data, see fnv1a in taglib.cpp
+func (m *module) fileImageHash(path string, h hint) ([]byte, uint64, error) {
+	ptr, err := m.callPath(exportFileReadImage, path, uint64(h), uint64(imageHash))
+	if err != nil || ptr == 0 {
+		return nil, 0, err
 	}
-	if !out {
-		return ErrSavingFile
+	hash, ok := m.mod.Memory().ReadUint64Le(uint32(ptr) + 8)
+	if !ok {
+		panic("memory error")
 	}
-	return nil
+	return pictureView(m, uint32(ptr)), hash, nil
 }
 
-// ClearImages removes all images from the file at path
-func ClearImages(path string) error {
-	var err error
-	path, err = filepath.Abs(path)
+func (m *module) fileWriteImage(path string, img []byte) (bool, error) {
+	pathArg := m.stageString(path)
+	imgArg := m.stageBytes(img)
+	base, err := m.flush()
 	if err != nil {
-		return fmt.Errorf("make path abs %w", err)
+		return false, err
 	}
+	out, err := m.call(exportFileWriteImage, uint64(base+pathArg), uint64(base+imgArg), uint64(len(img)))
+	return out == 1, err
+}
 
-	mod, err := newModule(filepath.Dir(path))
+// fileWriteImageMany returns the status of each path, see taglib_file_write_image_many
+func (m *module) fileWriteImageMany(paths []string, img []byte, opts ImageOptions) ([]uint32, error) {
+	pathsArg := m.stageStrings(paths)
+	imgArg := m.stageBytes(img)
+	optsArg := m.stageStrings([]string{opts.Type, opts.MIMEType, opts.Description})
+	base, err := m.flush()
 	if err != nil {
-		return fmt.Errorf("init module: %w", err)
+		return nil, err
+	}
+	ptr, err := m.call(exportFileWriteImageMany, uint64(base+pathsArg), uint64(base+imgArg), uint64(len(img)), uint64(base+optsArg))
+	if err != nil {
+		return nil, err
 	}
-	defer mod.close()
 
-	var out bool
-	if err := mod.call("taglib_file_clear_images", &out, wasmPath(path)); err != nil {
-		return fmt.Errorf("call: %w", err)
+	d := decoder{s: string(readPacked(m, uint32(ptr)))}
+	if d.u32() != uint32(len(paths)) {
+		panic("malformed batch buffer")
 	}
-	if !out {
-		return ErrSavingFile
+	statuses := make([]uint32, len(paths))
+	for i := range statuses {
+		statuses[i] = d.u32()
 	}
-	return nil
+	if !d.ok() {
+		panic("malformed batch buffer")
+	}
+	return statuses, nil
 }
 
-// WriteOption configures the behavior of write operations. The can be passed to [WriteTags] and combined with the bitwise OR operator.
-type WriteOption uint8
-
-const (
-	// Clear indicates that all existing tags not present in the new map should be removed.
-	Clear WriteOption = 1 << iota
+// Options of taglib_file_apply on top of those of taglib_file_write_tags, see taglib.cpp
+const clearImages = 1 << 2
 
-	// DiffBeforeWrite enables comparison before writing to disk.
-	// When set, no write occurs if the map contains no changes compared to the existing tags.
-	DiffBeforeWrite
-)
+func (m *module) fileApply(path string, mut Mutation) (WriteResult, uint32, error) {
+	var opts uint8
+	if mut.ClearTags {
+		opts |= uint8(Clear)
+	}
+	if mut.ClearImages {
+		opts |= clearImages
+	}
 
-// WriteTags writes the metadata key-values pairs to path. The behavior can be controlled with [WriteOption].
-func WriteTags(path string, tags map[string][]string, opts WriteOption) error {
-	var err error
-	path, err = filepath.Abs(path)
+	pathArg := m.stageString(path)
+	tagsArg := m.stageTags(mut.Tags)
+	imagesArg := m.stageImages(mut.Images)
+	base, err := m.flush()
 	if err != nil {
-		return fmt.Errorf("make path abs %w", err)
+		return WriteResult{}, 0, err
 	}
-
-	dir := filepath.Dir(path)
-	mod, err := newModule(dir)
+	padding := min(max(mut.Padding, 0), math.MaxInt32)
+	ptr, err := m.call(exportFileApply, uint64(base+pathArg), uint64(base+tagsArg), uint64(base+imagesArg), uint64(opts), uint64(padding))
 	if err != nil {
-		return fmt.Errorf("init module: %w", err)
+		return WriteResult{}, 0, err
 	}
-	defer mod.close()
 
-	var raw []string
-	for k, vs := range tags {
-		raw = append(raw, fmt.Sprintf("%s\t%s", k, strings.Join(vs, "\v")))
+	d := decoder{s: string(readPacked(m, uint32(ptr)))}
+	status, saved, shifts := d.u32(), d.u32(), d.u32()
+	if !d.ok() {
+		panic("malformed apply buffer")
 	}
+	return WriteResult{Saved: saved == 1, InPlace: saved == 1 && shifts == 0, Shifts: int(shifts)}, status, nil
+}
 
-	var out bool
-	if err := mod.call("taglib_file_write_tags", &out, wasmPath(path), raw, uint8(opts)); err != nil {
-		return fmt.Errorf("call: %w", err)
-	}
-	if !out {
-		return ErrSavingFile
-	}
-	return nil
+func (m *module) fileClearImages(path string) (bool, error) {
+	out, err := m.callPath(exportFileClearImages, path)
+	return out == 1, err
 }
 
-type rc struct {
-	wazero.Runtime
-	wazero.CompiledModule
+func (m *module) fileReadAll(path string, fields Field, style ReadStyle, h hint) (Result, bool, error) {
+	ptr, err := m.callPath(exportFileReadAll, path, uint64(fields), uint64(style), uint64(h))
+	if err != nil || ptr == 0 {
+		return Result{}, false, err
+	}
+	return readResult(m, uint32(ptr)), true, nil
 }
 
-var getRuntimeOnce = sync.OnceValues(func() (rc, error) {
-	ctx := context.Background()
+// fileTagsBatch returns the tags of each path, or nil for the ones that couldn't be read
+func (m *module) fileTagsBatch(paths []string, hints []hint) ([]map[string][]string, error) {
+	packed := make([]byte, 0, 4*len(hints))
+	for _, h := range hints {
+		packed = appendUint32(packed, uint32(h))
+	}
 
-	cacheDir := filepath.Join(os.TempDir(), "go-taglib-wasm")
-	compilationCache, err := wazero.NewCompilationCacheWithDir(cacheDir)
+	pathsArg := m.stageStrings(paths)
+	hintsArg := m.stageBytes(packed)
+	base, err := m.flush()
 	if err != nil {
-		return rc{}, err
+		return nil, err
 	}
-
-	runtime := wazero.NewRuntimeWithConfig(ctx,
-		wazero.NewRuntimeConfig().
-			WithCompilationCache(compilationCache),
-	)
-	wasi_snapshot_preview1.MustInstantiate(ctx, runtime)
-
-	_, err = runtime.
-		NewHostModuleBuilder("env").
-		NewFunctionBuilder().WithFunc(func(int32) int32 { panic("__cxa_allocate_exception") }).Export("__cxa_allocate_exception").
-		NewFunctionBuilder().WithFunc(func(int32, int32, int32) { panic("__cxa_throw") }).Export("__cxa_throw").
-		Instantiate(ctx)
+	ptr, err := m.call(exportFileTagsBatch, uint64(base+pathsArg), uint64(base+hintsArg))
 	if err != nil {
-		return rc{}, err
+		return nil, err
 	}
 
-	var bin = binary
-	if binaryPath != "" {
-		bin, err = os.ReadFile(binaryPath)
-		if err != nil {
-			return rc{}, fmt.Errorf("read custom binary path: %w", err)
-		}
-		clear(binary)
+	d := decoder{s: string(readPacked(m, uint32(ptr)))}
+	count := d.u32()
+	if count != uint32(len(paths)) {
+		panic("malformed batch buffer")
 	}
-
-	compiled, err := runtime.CompileModule(ctx, bin)
-	if err != nil {
-		return rc{}, err
+	tags := make([]map[string][]string, count)
+	for i := range tags {
+		if d.u32() != statusOK {
+			continue
+		}
+		if tags[i] = d.tags(); tags[i] == nil {
+			panic("malformed batch buffer")
+		}
 	}
+	return tags, nil
+}
 
-	return rc{
-		Runtime:        runtime,
-		CompiledModule: compiled,
-	}, nil
-})
+// Options of taglib_file_tags_keys, see taglib.cpp
+const (
+	keysOnly = 1 << iota
+	allKeys
+)
 
-type module struct {
-	mod api.Module
+func (m *module) fileTagsKeys(path string, keys []string, h hint) (map[string][]string, error) {
+	ptr, err := m.callTagsKeys(path, keys, h, 0)
+	if err != nil || ptr == 0 {
+		return nil, err
+	}
+	return readTags(m, uint32(ptr)), nil
 }
 
-func newModule(dir string) (module, error)   { return newModuleOpt(dir, false) }
-func newModuleRO(dir string) (module, error) { return newModuleOpt(dir, true) }
-func newModuleOpt(dir string, readOnly bool) (module, error) {
-	rt, err := getRuntimeOnce()
-	if err != nil {
-		return module{}, fmt.Errorf("get runtime once: %w", err)
+func (m *module) fileTagKeyCounts(path string, h hint) (map[string]int, error) {
+	ptr, err := m.callTagsKeys(path, nil, h, keysOnly|allKeys)
+	if err != nil || ptr == 0 {
+		return nil, err
 	}
-
-	fsConfig := wazero.NewFSConfig()
-	if readOnly {
-		fsConfig = fsConfig.WithReadOnlyDirMount(dir, wasmPath(dir))
-	} else {
-		fsConfig = fsConfig.WithDirMount(dir, wasmPath(dir))
+	d := decoder{s: string(readPacked(m, uint32(ptr)))}
+	counts := d.counts()
+	if counts == nil {
+		panic("malformed tag buffer")
 	}
+	return counts, nil
+}
 
-	cfg := wazero.
-		NewModuleConfig().
-		WithName("").
-		WithStartFunctions("_initialize").
-		WithFSConfig(fsConfig)
-
-	ctx := context.Background()
-	mod, err := rt.Runtime.InstantiateModule(ctx, rt.CompiledModule, cfg)
+func (m *module) callTagsKeys(path string, keys []string, h hint, opts uint8) (uint64, error) {
+	pathArg := m.stageString(path)
+	keysArg := m.stageStrings(keys)
+	base, err := m.flush()
 	if err != nil {
-		return module{}, err
+		return 0, err
 	}
-
-	return module{
-		mod: mod,
-	}, nil
+	return m.call(exportFileTagsKeys, uint64(base+pathArg), uint64(base+keysArg), uint64(h), uint64(opts))
 }
 
-func (m *module) malloc(size uint32) uint32 {
-	var ptr uint32
-	if err := m.call("malloc", &ptr, size); err != nil {
-		panic(err)
+func (m *module) bytesTags(b []byte, h hint) (map[string][]string, error) {
+	ptr, err := m.callBytes(exportBytesTags, b, uint64(h))
+	if err != nil || ptr == 0 {
+		return nil, err
 	}
-	if ptr == 0 {
-		panic("no ptr")
-	}
-	return ptr
+	return readTags(m, uint32(ptr)), nil
 }
 
-func (m *module) call(name string, dest any, args ...any) error {
-	params := make([]uint64, 0, len(args))
-	for _, a := range args {
-		switch a := a.(type) {
-		case bool:
-			if a {
-				params = append(params, 1)
-			} else {
-				params = append(params, 0)
-			}
-		case int:
-			params = append(params, uint64(a))
-		case uint8:
-			params = append(params, uint64(a))
-		case uint32:
-			params = append(params, uint64(a))
-		case uint64:
-			params = append(params, a)
-		case []byte:
-			params = append(params, uint64(makeByteArray(m, a)))
-		case string:
-			params = append(params, uint64(makeString(m, a)))
-		case []string:
-			params = append(params, uint64(makeStrings(m, a)))
-		default:
-			panic(fmt.Sprintf("unknown argument type %T", a))
-		}
+func (m *module) bytesAudioProperties(b []byte, h hint) (Properties, bool, error) {
+	ptr, err := m.callBytes(exportBytesAudioProperties, b, uint64(h))
+	if err != nil || ptr == 0 {
+		return Properties{}, false, err
 	}
+	return readProperties(m, uint32(ptr)), true, nil
+}
 
-	results, err := m.mod.ExportedFunction(name).Call(context.Background(), params...)
-	if err != nil {
-		return fmt.Errorf("call %q: %w", name, err)
+func (m *module) bytesReadImage(b []byte, h hint) ([]byte, error) {
+	ptr, err := m.callBytes(exportBytesReadImage, b, uint64(h))
+	if err != nil || ptr == 0 {
+		return nil, err
 	}
-	if len(results) == 0 {
-		return nil
+	return readPicture(m, uint32(ptr)), nil
+}
+
+// streamTags reads tags through m.stream
+func (m *module) streamTags() (map[string][]string, error) {
+	if _, err := m.flush(); err != nil {
+		return nil, err
 	}
-	result := results[0]
-
-	switch dest := dest.(type) {
-	case *int:
-		*dest = int(result)
-	case *uint32:
-		*dest = uint32(result)
-	case *uint64:
-		*dest = uint64(result)
-	case *bool:
-		*dest = result == 1
-	case *string:
-		if result != 0 {
-			*dest = readString(m, uint32(result))
-		}
-	case *[]string:
-		if result != 0 {
-			*dest = readStrings(m, uint32(result))
-		}
-	case *[]int:
-		if result != 0 {
-			*dest = readInts(m, uint32(result), cap(*dest))
-		}
-	case *picture:
-		if result != 0 {
-			*dest = readPicture(m, uint32(result))
-		}
-	default:
-		panic(fmt.Sprintf("unknown result type %T", dest))
+	ptr, err := m.call(exportStreamTags)
+	if err != nil || ptr == 0 {
+		return nil, err
 	}
-	return nil
+	return readTags(m, uint32(ptr)), nil
 }
 
-func (m *module) close() {
-	if err := m.mod.Close(context.Background()); err != nil {
-		panic(err)
+// streamWriteTags writes tags through m.stream
+func (m *module) streamWriteTags(tags map[string][]string, opts WriteOption) (bool, error) {
+	tagsArg := m.stageTags(tags)
+	base, err := m.flush()
+	if err != nil {
+		return false, err
 	}
+	out, err := m.call(exportStreamWriteTags, uint64(base+tagsArg), uint64(opts))
+	return out == 1, err
 }
 
-func makeByteArray(m *module, b []byte) uint32 {
-	ptr := m.malloc(uint32(len(b)))
-	if !m.mod.Memory().Write(ptr, b) {
-		panic("failed to write to mod.module.Memory()")
+func (m *module) open(path string, h hint) (uint32, error) {
+	handle, err := m.callPath(exportOpen, path, uint64(h))
+	return uint32(handle), err
+}
+
+func (m *module) closeHandle(handle uint32) error {
+	_, err := m.callHandle(exportClose, handle)
+	return err
+}
+
+func (m *module) handleTags(handle uint32) (map[string][]string, error) {
+	ptr, err := m.callHandle(exportHandleTags, handle)
+	if err != nil || ptr == 0 {
+		return nil, err
 	}
-	return ptr
+	return readTags(m, uint32(ptr)), nil
 }
 
-func makeString(m *module, s string) uint32 {
-	b := append([]byte(s), 0)
-	ptr := m.malloc(uint32(len(b)))
-	if !m.mod.Memory().Write(ptr, b) {
-		panic("failed to write to mod.module.Memory()")
+func (m *module) handleAudioProperties(handle uint32) (Properties, bool, error) {
+	ptr, err := m.callHandle(exportHandleAudioProperties, handle)
+	if err != nil || ptr == 0 {
+		return Properties{}, false, err
 	}
-	return ptr
+	return readProperties(m, uint32(ptr)), true, nil
 }
 
-func makeStrings(m *module, s []string) uint32 {
-	arrayPtr := m.malloc(uint32((len(s) + 1) * 4))
-	for i, s := range s {
-		b := append([]byte(s), 0)
-		ptr := m.malloc(uint32(len(b)))
-		if !m.mod.Memory().Write(ptr, b) {
-			panic("failed to write to mod.module.Memory()")
-		}
-		if !m.mod.Memory().WriteUint32Le(arrayPtr+uint32(i*4), ptr) {
-			panic("failed to write pointer to mod.module.Memory()")
-		}
+func (m *module) handleReadImage(handle uint32) ([]byte, error) {
+	ptr, err := m.callHandle(exportHandleReadImage, handle)
+	if err != nil || ptr == 0 {
+		return nil, err
 	}
-	if !m.mod.Memory().WriteUint32Le(arrayPtr+uint32(len(s)*4), 0) {
-		panic("failed to write pointer to memory")
+	return readPicture(m, uint32(ptr)), nil
+}
+
+func (m *module) handleSetTags(handle uint32, tags map[string][]string, opts WriteOption) (bool, error) {
+	tagsArg := m.stageTags(tags)
+	base, err := m.flush()
+	if err != nil {
+		return false, err
 	}
-	return arrayPtr
+	out, err := m.call(exportHandleSetTags, uint64(handle), uint64(base+tagsArg), uint64(opts))
+	return out == 1, err
+}
+
+func (m *module) handleSave(handle uint32) (bool, error) {
+	out, err := m.callHandle(exportHandleSave, handle)
+	return out == 1, err
+}
+
+// close returns the instance to its pool, or discards it if it has been used up
+func (m *module) close() {
+	putModule(m)
+}
+
+// worn reports whether the instance should be discarded rather than reused. Callers that keep an instance checked
+// out across many files check it between files, since the pool only can when it's returned
+func (m *module) worn() bool {
+	return m.uses >= moduleMaxUses || m.mod.Memory().Size() > moduleMaxMemory
 }
 
 func readString(m *module, ptr uint32) string {
@@ -601,7 +2012,13 @@ func readString(m *module, ptr uint32) string {
 	}
 }
 
-func readPicture(m *module, ptr uint32) picture {
+func readPicture(m *module, ptr uint32) []byte {
+	// Copy the data. "This returns a view of the underlying memory, not a copy." per api.Memory.Read docs
+	return bytes.Clone(pictureView(m, ptr))
+}
+
+// pictureView returns a view of the data of the picture struct at ptr
+func pictureView(m *module, ptr uint32) []byte {
 	size, ok := m.mod.Memory().ReadUint32Le(ptr)
 	if !ok {
 		panic("memory error")
@@ -617,43 +2034,210 @@ func readPicture(m *module, ptr uint32) picture {
 	if !ok {
 		panic("memory error")
 	}
+	return b
+}
 
-	// Copy the data. "This returns a view of the underlying memory, not a copy." per api.Memory.Read docs
-	ret := make(picture, size)
-	copy(ret, b)
-	return ret
+// readProperties reads the int[4] of audio properties
+func readProperties(m *module, ptr uint32) Properties {
+	b, ok := m.mod.Memory().Read(ptr, 16)
+	if !ok {
+		panic("memory error")
+	}
+	return Properties{
+		Length:     time.Duration(int32(getUint32(b[0:]))) * time.Millisecond,
+		Channels:   uint(getUint32(b[4:])),
+		SampleRate: uint(getUint32(b[8:])),
+		Bitrate:    uint(getUint32(b[12:])),
+	}
 }
 
-func readStrings(m *module, ptr uint32) []string {
-	strs := []string{} // non nil so call knows if it's just empty
-	for {
-		stringPtr, ok := m.mod.Memory().ReadUint32Le(ptr)
+// readResult reads a file_info struct
+func readResult(m *module, ptr uint32) Result {
+	var res Result
+
+	if tagsPtr, _ := m.mod.Memory().ReadUint32Le(ptr); tagsPtr != 0 {
+		res.Tags = readTags(m, tagsPtr)
+	}
+
+	if propsPtr, _ := m.mod.Memory().ReadUint32Le(ptr + 4); propsPtr != 0 {
+		res.Properties = readProperties(m, propsPtr)
+	}
+
+	count, _ := m.mod.Memory().ReadUint32Le(ptr + 8)
+	imagesPtr, _ := m.mod.Memory().ReadUint32Le(ptr + 12)
+	for i := range count {
+		infoPtr := imagesPtr + i*40
+		typePtr, _ := m.mod.Memory().ReadUint32Le(infoPtr)
+		mimePtr, _ := m.mod.Memory().ReadUint32Le(infoPtr + 4)
+		descPtr, _ := m.mod.Memory().ReadUint32Le(infoPtr + 8)
+		size, _ := m.mod.Memory().ReadUint32Le(infoPtr + 12)
+		width, _ := m.mod.Memory().ReadUint32Le(infoPtr + 16)
+		height, _ := m.mod.Memory().ReadUint32Le(infoPtr + 20)
+		detectedPtr, _ := m.mod.Memory().ReadUint32Le(infoPtr + 24)
+		hash, ok := m.mod.Memory().ReadUint64Le(infoPtr + 32)
 		if !ok {
 			panic("memory error")
 		}
-		if stringPtr == 0 {
-			break
+		info := ImageInfo{
+			Type:        readString(m, typePtr),
+			MIMEType:    readString(m, mimePtr),
+			Description: readString(m, descPtr),
+			Size:        int(size),
+			Index:       int(i),
+			Width:       int(width),
+			Height:      int(height),
+			Hash:        hash,
+		}
+		if detectedPtr != 0 {
+			info.DetectedMIMEType = readString(m, detectedPtr)
 		}
-		str := readString(m, stringPtr)
-		strs = append(strs, str)
-		ptr += 4
+		res.Images = append(res.Images, info)
 	}
-	return strs
+	return res
 }
 
-func readInts(m *module, ptr uint32, len int) []int {
-	ints := make([]int, 0, len)
-	for i := range len {
-		i, ok := m.mod.Memory().ReadUint32Le(ptr + uint32(4*i))
-		if !ok {
-			panic("memory error")
+// Per file status codes of batch calls, see taglib.cpp
+const (
+	statusOK = iota
+	statusInvalidFile
+	statusSaveFailed
+)
+
+// readPacked returns a view of a buffer made by packer in taglib.cpp, without its size header.
+// It starts with its total size so it can be read in one go
+func readPacked(m *module, ptr uint32) []byte {
+	size, ok := m.mod.Memory().ReadUint32Le(ptr)
+	if !ok {
+		panic("memory error")
+	}
+	buf, ok := m.mod.Memory().Read(ptr, size)
+	if !ok || size < 4 {
+		panic("memory error")
+	}
+	return buf[4:]
+}
+
+func readTags(m *module, ptr uint32) map[string][]string {
+	d := decoder{s: string(readPacked(m, ptr))}
+	tags := d.tags()
+	if tags == nil {
+		panic("malformed tag buffer")
+	}
+	return tags
+}
+
+// decoder reads little endian u32s and u32 length prefixed strings, and records if it ran out of bytes
+type decoder struct {
+	s   string
+	bad bool
+}
+
+func (d *decoder) ok() bool { return !d.bad }
+
+// tags decodes tags packed by pack_tags in taglib.cpp, or returns nil if they're malformed. The keys and values
+// are substrings of the decoder's string and the value slices are windows of one backing array, so the number
+// of allocations doesn't depend on the number of tags
+func (d *decoder) tags() map[string][]string {
+	count, total := d.u32(), d.u32()
+	if !d.ok() || uint64(count)+uint64(total) > uint64(len(d.s)/4) {
+		return nil
+	}
+
+	tags := make(map[string][]string, count)
+	values := make([]string, total)
+	for range count {
+		k := d.str()
+		n := d.u32()
+		if !d.ok() || n > total {
+			return nil
+		}
+		vs := values[:n:n]
+		values, total = values[n:], total-n
+		for i := range vs {
+			vs[i] = d.str()
 		}
-		ints = append(ints, int(i))
+		tags[k] = vs
+	}
+	if !d.ok() {
+		return nil
+	}
+	return tags
+}
+
+// truncated decodes the list of cut values that pack_tags in taglib.cpp adds after the tags
+func (d *decoder) truncated() []TruncatedValue {
+	count := d.u32()
+	if !d.ok() || uint64(count) > uint64(len(d.s)/12) {
+		d.bad = true
+		return nil
+	}
+
+	var vs []TruncatedValue
+	for range count {
+		vs = append(vs, TruncatedValue{Key: d.str(), Index: int(d.u32()), Size: int(d.u32())})
+	}
+	return vs
+}
+
+// counts decodes the keys and value counts packed by taglib_file_tags_keys in keys only mode, or returns nil if
+// they're malformed
+func (d *decoder) counts() map[string]int {
+	count := d.u32()
+	if !d.ok() || uint64(count) > uint64(len(d.s)/8) {
+		return nil
+	}
+
+	counts := make(map[string]int, count)
+	for range count {
+		k := d.str()
+		counts[k] = int(d.u32())
 	}
-	return ints
+	if !d.ok() {
+		return nil
+	}
+	return counts
+}
+
+func (d *decoder) u32() uint32 {
+	if len(d.s) < 4 {
+		d.bad, d.s = true, ""
+		return 0
+	}
+	v := uint32(d.s[0]) | uint32(d.s[1])<<8 | uint32(d.s[2])<<16 | uint32(d.s[3])<<24
+	d.s = d.s[4:]
+	return v
+}
+
+func (d *decoder) str() string {
+	n := d.u32()
+	if uint32(len(d.s)) < n {
+		d.bad, d.s = true, ""
+		return ""
+	}
+	v := d.s[:n]
+	d.s = d.s[n:]
+	return v
+}
+
+func appendUint32(b []byte, v uint32) []byte {
+	return append(b, byte(v), byte(v>>8), byte(v>>16), byte(v>>24))
+}
+
+func putUint32(b []byte, v uint32) {
+	b[0], b[1], b[2], b[3] = byte(v), byte(v>>8), byte(v>>16), byte(v>>24)
+}
+
+func getUint32(b []byte) uint32 {
+	return uint32(b[0]) | uint32(b[1])<<8 | uint32(b[2])<<16 | uint32(b[3])<<24
+}
+
+// mountRoot is the host directory that an instance mounts for path, at its own [wasmPath] in the guest.
+// Only files in it can be reached, so an instance for one file can't touch the rest of the filesystem
+func mountRoot(p string) string {
+	return filepath.Dir(p)
 }
 
-// WASI uses POSIXy paths, even on Windows
+// WASI uses POSIXy paths, even on Windows. The volume is stripped since the guest has a single root
 func wasmPath(p string) string {
-	return filepath.ToSlash(p)
+	return filepath.ToSlash(p[len(filepath.VolumeName(p)):])
 }
@@ -1,10 +1,14 @@
 package taglib_test
 
 import (
+	"bytes"
+	"context"
 	_ "embed"
 	"errors"
 	"fmt"
+	"hash/fnv"
 	"image"
+	"io"
 	"maps"
 	"os"
 	"path/filepath"
@@ -26,6 +30,146 @@ func TestInvalid(t *testing.T) {
 	eq(t, err, taglib.ErrInvalidFile)
 }
 
+func TestDetectFormat(t *testing.T) {
+	t.Parallel()
+
+	for _, tc := range []struct {
+		name string
+		b    []byte
+		want taglib.Format
+	}{
+		{"eg.flac", egFLAC, taglib.FormatFLAC},
+		{"eg.mp3", egMP3, taglib.FormatMPEG},
+		{"eg.m4a", egM4a, taglib.FormatMP4},
+		{"eg.ogg", egOgg, taglib.FormatOggVorbis},
+		{"eg.wav", egWAV, taglib.FormatWAV},
+	} {
+		t.Run(tc.name, func(t *testing.T) {
+			path := tmpf(t, tc.b, tc.name)
+			format, err := taglib.DetectFormat(path)
+			nilErr(t, err)
+			eq(t, tc.want, format)
+
+			res, err := taglib.ReadAll(path)
+			nilErr(t, err)
+			eq(t, tc.want, res.Format)
+		})
+	}
+
+	// not recognized, but not clearly anything else either, so left to TagLib
+	for _, tc := range []struct {
+		name string
+		b    []byte
+	}{
+		{"free.m4a", append([]byte("\x00\x00\x00\x08free"), egM4a...)},         // first box isn't ftyp
+		{"junk.mp3", append(bytes.Repeat([]byte{0x00, 0x11}, 4096), egMP3...)}, // first frame past the sniffed head
+		{"eg.mod", append([]byte("song title"), make([]byte, 2048)...)},        // 15 sample Mod has no signature
+		{"eg.mpc", []byte("\x16\x02\x00\x00\x7c\x11\x00\x00binary")},           // nor does Musepack before SV7
+	} {
+		t.Run(tc.name, func(t *testing.T) {
+			format, err := taglib.DetectFormat(tmpf(t, tc.b, tc.name))
+			nilErr(t, err)
+			eq(t, taglib.FormatUnknown, format)
+		})
+	}
+
+	_, err := taglib.ReadTags(tmpf(t, append([]byte("\x00\x00\x00\x08free"), egM4a...), "free.m4a"))
+	nilErr(t, err)
+
+	// not audio, even with an audio extension, or MPEG frames after the signature
+	mp3Frames := egMP3[10+1042:] // after the ID3v2 tag
+	for _, b := range [][]byte{
+		coverPNG, []byte("not a file"), []byte("%PDF-1.7\n\x00\xff"), []byte("PK\x03\x04\x00\x00"), nil,
+		slices.Concat([]byte("\x89PNG\r\n\x1a\n"), mp3Frames), slices.Concat([]byte("PK\x03\x04"), mp3Frames),
+	} {
+		_, err := taglib.DetectFormat(tmpf(t, b, "eg.mp3"))
+		eq(t, err, taglib.ErrInvalidFile)
+	}
+}
+
+func TestReadTagsWith(t *testing.T) {
+	t.Parallel()
+
+	path := tmpf(t, egMP3, "eg.mp3")
+	err := taglib.WriteTags(path, map[string][]string{
+		"TITLE":    {"Title"},
+		"LYRICIST": {"Lyricist"}, // not in ID3v1
+	}, taglib.Clear)
+	nilErr(t, err)
+
+	got, err := taglib.ReadTagsWith(path, taglib.ReadOptions{Format: taglib.FormatMPEG, MaxValueBytes: 3})
+	nilErr(t, err)
+	tagEq(t, got, map[string][]string{"TITLE": {"Title"}, "LYRICIST": {"Lyricist"}}) // not cut
+
+	got, err = taglib.ReadTagsWith(path, taglib.ReadOptions{MPEGTags: taglib.MPEGTagID3v1})
+	nilErr(t, err)
+	tagEq(t, got, map[string][]string{"TITLE": {"Title"}})
+
+	_, err = taglib.ReadTagValue(path, "LYRICIST", 0, taglib.ReadOptions{MPEGTags: taglib.MPEGTagID3v1})
+	if err == nil {
+		t.Fatalf("expected error for value not in ID3v1")
+	}
+	value, err := taglib.ReadTagValue(path, "LYRICIST", 0, taglib.ReadOptions{MPEGTags: taglib.MPEGTagID3v2})
+	nilErr(t, err)
+	eq(t, value, "Lyricist")
+}
+
+func TestReadTagsKeys(t *testing.T) {
+	t.Parallel()
+
+	path := tmpf(t, egFLAC, "eg.flac")
+	err := taglib.WriteTags(path, map[string][]string{
+		"TITLE":  {"Title"},
+		"ARTIST": {"Artist A", "Artist B"},
+		"LYRICS": {longString},
+	}, taglib.Clear)
+	nilErr(t, err)
+
+	got, err := taglib.ReadTagsKeys(path, "TITLE", "ARTIST", "MISSING")
+	nilErr(t, err)
+	tagEq(t, got, map[string][]string{"TITLE": {"Title"}, "ARTIST": {"Artist A", "Artist B"}})
+
+	got, err = taglib.ReadTagsKeys(path)
+	nilErr(t, err)
+	tagEq(t, got, map[string][]string{})
+
+	_, err = taglib.ReadTagsKeys(tmpf(t, []byte("not a file"), "eg.flac"))
+	eq(t, err, taglib.ErrInvalidFile)
+
+	counts, err := taglib.ReadTagKeyCounts(path)
+	nilErr(t, err)
+	if !maps.Equal(counts, map[string]int{"TITLE": 1, "ARTIST": 2, "LYRICS": 1}) {
+		t.Fatalf("got counts %v", counts)
+	}
+}
+
+func TestReadTagsTruncated(t *testing.T) {
+	t.Parallel()
+
+	path := tmpf(t, egFLAC, "eg.flac")
+	err := taglib.WriteTags(path, map[string][]string{
+		"TITLE":  {"Title"},
+		"LYRICS": {"short", "ääääää"}, // 12 bytes
+	}, taglib.Clear)
+	nilErr(t, err)
+
+	tags, truncated, err := taglib.ReadTagsTruncated(path, taglib.ReadOptions{MaxValueBytes: 5})
+	nilErr(t, err)
+	// cut at a character boundary
+	tagEq(t, tags, map[string][]string{"TITLE": {"Title"}, "LYRICS": {"short", "ää"}})
+	eq(t, len(truncated), 1)
+	eq(t, truncated[0], taglib.TruncatedValue{Key: "LYRICS", Index: 1, Size: 12})
+
+	value, err := taglib.ReadTagValue(path, truncated[0].Key, truncated[0].Index, taglib.ReadOptions{})
+	nilErr(t, err)
+	eq(t, value, "ääääää")
+
+	_, err = taglib.ReadTagValue(path, "LYRICS", 2, taglib.ReadOptions{})
+	if err == nil {
+		t.Fatalf("expected error for missing value")
+	}
+}
+
 func TestClear(t *testing.T) {
 	t.Parallel()
 
@@ -179,6 +323,16 @@ func TestMergeWrite(t *testing.T) {
 				"TWO":   {"two", "two!"},
 				"THREE": {"three new!"},
 			})
+
+			// a single empty value removes the key too
+			err = taglib.WriteTags(path, map[string][]string{
+				"TWO": {""},
+			}, 0)
+
+			nilErr(t, err)
+			cmp(t, path, map[string][]string{
+				"THREE": {"three new!"},
+			})
 		})
 	}
 }
@@ -228,6 +382,26 @@ func TestAudioProperties(t *testing.T) {
 	eq(t, 2, properties.Channels)
 }
 
+func TestAudioPropertiesStyle(t *testing.T) {
+	t.Parallel()
+
+	path := tmpf(t, egMP3, "eg.mp3")
+
+	want, err := taglib.ReadProperties(path)
+	nilErr(t, err)
+
+	// Only the length is allowed to be estimated
+	for _, style := range []taglib.ReadStyle{taglib.ReadFast, taglib.ReadAverage, taglib.ReadAccurate} {
+		properties, err := taglib.ReadPropertiesWithStyle(path, style)
+		nilErr(t, err)
+		eq(t, want.SampleRate, properties.SampleRate)
+		eq(t, want.Channels, properties.Channels)
+		if properties.Length == 0 {
+			t.Errorf("style %d: no length", style)
+		}
+	}
+}
+
 func TestMultiOpen(t *testing.T) {
 	t.Parallel()
 
@@ -259,6 +433,177 @@ func TestReadImageRaw(t *testing.T) {
 	}
 }
 
+func TestReadImageInto(t *testing.T) {
+	path := tmpf(t, egFLAC, "eg.flac")
+	err := taglib.WriteImageRaw(path, coverPNG)
+	nilErr(t, err)
+
+	size, err := taglib.ImageSize(path)
+	nilErr(t, err)
+	eq(t, size, len(coverPNG))
+
+	dst := make([]byte, size)
+	n, err := taglib.ReadImageInto(path, dst)
+	nilErr(t, err)
+	eq(t, n, size)
+	if !bytes.Equal(dst, coverPNG) {
+		t.Fatalf("image data differs")
+	}
+
+	n, err = taglib.ReadImageInto(path, dst[:10])
+	eq(t, err, io.ErrShortBuffer)
+	eq(t, n, 10)
+
+	var buf bytes.Buffer
+	written, err := taglib.WriteImageTo(path, &buf)
+	nilErr(t, err)
+	eq(t, written, int64(len(coverPNG)))
+	if !bytes.Equal(buf.Bytes(), coverPNG) {
+		t.Fatalf("written image data differs")
+	}
+
+	err = taglib.ClearImages(path)
+	nilErr(t, err)
+	size, err = taglib.ImageSize(path)
+	nilErr(t, err)
+	eq(t, size, 0)
+}
+
+func TestListImages(t *testing.T) {
+	path := tmpf(t, egFLAC, "eg.flac")
+	err := taglib.WriteImageRaw(path, coverPNG)
+	nilErr(t, err)
+
+	images, err := taglib.ListImages(path)
+	nilErr(t, err)
+	eq(t, len(images), 1)
+	eq(t, images[0], taglib.ImageInfo{
+		Type:        "Front Cover",
+		MIMEType:    "image/png",
+		Description: "Added by go-taglib",
+		Size:        len(coverPNG),
+		Index:       0,
+	})
+
+	img, err := taglib.ReadImageAt(path, images[0].Index)
+	nilErr(t, err)
+	if !bytes.Equal(img, coverPNG) {
+		t.Fatalf("image data differs")
+	}
+
+	_, err = taglib.ReadImageAt(path, 1)
+	if err == nil {
+		t.Fatalf("expected error for missing image")
+	}
+}
+
+func TestInspectImages(t *testing.T) {
+	path := tmpf(t, egFLAC, "eg.flac")
+	err := taglib.WriteImageRaw(path, coverPNG)
+	nilErr(t, err)
+
+	images, err := taglib.InspectImages(path)
+	nilErr(t, err)
+	eq(t, len(images), 1)
+	eq(t, images[0].Width, 700)
+	eq(t, images[0].Height, 700)
+	eq(t, images[0].DetectedMIMEType, "image/png")
+
+	h := fnv.New64a()
+	h.Write(coverPNG)
+	eq(t, images[0].Hash, h.Sum64())
+}
+
+func TestInspectImageFormats(t *testing.T) {
+	t.Parallel()
+
+	// segments that the walk to the JPEG frame header must step over
+	jpegWith := func(insert string) []byte {
+		return slices.Concat(imageJPEG[:2], []byte(insert), imageJPEG[2:])
+	}
+
+	for _, tc := range []struct {
+		name          string
+		b             []byte
+		mime          string
+		width, height int
+	}{
+		{"png", coverPNG, "image/png", 700, 700},
+		{"jpeg", imageJPEG, "image/jpeg", 12, 7},
+		{"jpeg fill bytes", jpegWith("\xff\xff\xff"), "image/jpeg", 12, 7},
+		{"jpeg restart marker", jpegWith("\xff\xd0"), "image/jpeg", 12, 7},
+		{"jpeg scan before frame", jpegWith("\xff\xda\x00\x08\x01\x01\x00\x00\x3f\x00"), "image/jpeg", 0, 0},
+		{"gif", imageGIF, "image/gif", 9, 4},
+		{"webp lossy", imageVP8, "image/webp", 5, 3},
+		{"webp lossless", imageVP8L, "image/webp", 4, 6},
+		{"webp extended", imageVP8X, "image/webp", 4, 6},
+		{"unknown", []byte("not an image"), "", 0, 0},
+	} {
+		t.Run(tc.name, func(t *testing.T) {
+			path := tmpf(t, egFLAC, "eg.flac")
+			err := taglib.WriteImageRaw(path, tc.b)
+			nilErr(t, err)
+
+			images, err := taglib.InspectImages(path)
+			nilErr(t, err)
+			eq(t, len(images), 1)
+			eq(t, images[0].DetectedMIMEType, tc.mime)
+			eq(t, images[0].Width, tc.width)
+			eq(t, images[0].Height, tc.height)
+		})
+	}
+}
+
+func TestExtractCovers(t *testing.T) {
+	a := tmpf(t, egFLAC, "a.flac")
+	b := tmpf(t, egFLAC, "b.flac")
+	c := tmpf(t, egFLAC, "c.flac")
+	err := taglib.ClearImages(c)
+	nilErr(t, err)
+
+	h := fnv.New64a()
+	h.Write(coverPNG)
+	want := h.Sum64()
+
+	hash, img, err := taglib.ReadImageHashed(a, func(uint64) bool { return false })
+	nilErr(t, err)
+	eq(t, hash, want)
+	eq(t, len(img), len(coverPNG))
+
+	hash, img, err = taglib.ReadImageHashed(a, func(h uint64) bool { return h == want })
+	nilErr(t, err)
+	eq(t, hash, want)
+	eq(t, img == nil, true)
+
+	store := coverStore{}
+	results, err := taglib.ExtractCovers([]string{a, b, c, "nonexistent"}, store)
+	nilErr(t, err)
+	eq(t, len(store), 1)
+	eq(t, bytes.Equal(store[want], coverPNG), true)
+
+	eq(t, results[0].Stored, true)
+	eq(t, results[0].Size, len(coverPNG))
+	eq(t, results[1].Stored, false)
+	eq(t, results[1].Hash, want)
+	eq(t, results[2].Hash, uint64(0))
+	eq(t, results[2].Err, nil)
+	eq(t, errors.Is(results[3].Err, taglib.ErrInvalidFile), true)
+
+	// Already stored images aren't put again
+	results, err = taglib.ExtractCovers([]string{a}, store)
+	nilErr(t, err)
+	eq(t, results[0].Stored, false)
+}
+
+type coverStore map[uint64][]byte
+
+func (s coverStore) Has(hash uint64) bool { _, ok := s[hash]; return ok }
+
+func (s coverStore) Put(hash uint64, img []byte) error {
+	s[hash] = bytes.Clone(img)
+	return nil
+}
+
 func TestReadImage(t *testing.T) {
 	path := tmpf(t, egFLAC, "eg.flac")
 	img, err := taglib.ReadImage(path)
@@ -279,7 +624,7 @@ func TestWriteImageRaw(t *testing.T) {
 	err := taglib.ClearImages(path)
 	nilErr(t, err)
 
-	err = taglib.WriteImageRaw(path, coverJPG)
+	err = taglib.WriteImageRaw(path, coverPNG)
 	nilErr(t, err)
 
 	img, err := taglib.ReadImage(path)
@@ -294,9 +639,142 @@ func TestWriteImageRaw(t *testing.T) {
 	}
 }
 
+func TestWriteImageMany(t *testing.T) {
+	a := tmpf(t, egFLAC, "a.flac")
+	b := tmpf(t, egMP3, "b.mp3")
+	bad := tmpf(t, []byte("not audio"), "bad.flac")
+
+	errs, err := taglib.WriteImageMany([]string{a, b, bad}, coverPNG, taglib.ImageOptions{Type: "Back Cover"})
+	nilErr(t, err)
+	nilErr(t, errs[0])
+	nilErr(t, errs[1])
+	eq(t, errors.Is(errs[2], taglib.ErrInvalidFile), true)
+
+	for _, path := range []string{a, b} {
+		images, err := taglib.ListImages(path)
+		nilErr(t, err)
+		eq(t, len(images), 1)
+		eq(t, images[0].Type, "Back Cover")
+		eq(t, images[0].MIMEType, "image/png")
+		eq(t, images[0].Description, "Added by go-taglib")
+
+		img, err := taglib.ReadImageAt(path, 0)
+		nilErr(t, err)
+		eq(t, bytes.Equal(img, coverPNG), true)
+	}
+
+	// more files in one directory than one guest call writes
+	dir := t.TempDir()
+	var paths []string
+	for i := range 2*64 + 1 {
+		path := filepath.Join(dir, fmt.Sprintf("%03d.mp3", i))
+		nilErr(t, os.WriteFile(path, egMP3, 0o644))
+		paths = append(paths, path)
+	}
+	paths[70] = filepath.Join(dir, "missing.mp3")
+
+	errs, err = taglib.WriteImageMany(paths, imageJPEG, taglib.ImageOptions{})
+	nilErr(t, err)
+	for i, path := range paths {
+		if i == 70 {
+			eq(t, errors.Is(errs[i], taglib.ErrInvalidFile), true)
+			continue
+		}
+		nilErr(t, errs[i])
+		img, err := taglib.ReadImageAt(path, 0)
+		nilErr(t, err)
+		eq(t, bytes.Equal(img, imageJPEG), true)
+	}
+}
+
+func TestApply(t *testing.T) {
+	path := tmpf(t, egFLAC, "eg.flac")
+
+	res, err := taglib.Apply(path, taglib.Mutation{
+		Tags: map[string][]string{
+			taglib.Title:  {"New Title"},
+			taglib.Artist: nil,
+		},
+		Images: []taglib.Image{
+			{Data: coverPNG, ImageOptions: taglib.ImageOptions{Type: "Back Cover", Description: "back"}},
+		},
+	})
+	nilErr(t, err)
+	eq(t, res.Saved, true)
+
+	tags, err := taglib.ReadTags(path)
+	nilErr(t, err)
+	eq(t, tags[taglib.Title][0], "New Title")
+	eq(t, len(tags[taglib.Artist]), 0)
+
+	images, err := taglib.ListImages(path)
+	nilErr(t, err)
+	eq(t, len(images), 2)
+	eq(t, images[1].Type, "Back Cover")
+	eq(t, images[1].Description, "back")
+
+	// A picture of the same type replaces the existing one
+	res, err = taglib.Apply(path, taglib.Mutation{
+		Images: []taglib.Image{{Data: coverPNG, ImageOptions: taglib.ImageOptions{Type: "Back Cover"}}},
+	})
+	nilErr(t, err)
+	eq(t, res.Saved, true)
+	images, err = taglib.ListImages(path)
+	nilErr(t, err)
+	eq(t, len(images), 2)
+
+	// No changes, no save
+	res, err = taglib.Apply(path, taglib.Mutation{Tags: map[string][]string{taglib.Title: {"New Title"}}})
+	nilErr(t, err)
+	eq(t, res.Saved, false)
+
+	res, err = taglib.Apply(path, taglib.Mutation{ClearImages: true})
+	nilErr(t, err)
+	eq(t, res.Saved, true)
+	images, err = taglib.ListImages(path)
+	nilErr(t, err)
+	eq(t, len(images), 0)
+}
+
+func TestApplyPadding(t *testing.T) {
+	path := tmpf(t, egFLAC, "eg.flac")
+	comment := func(n int) taglib.Mutation {
+		return taglib.Mutation{Tags: map[string][]string{taglib.Comment: {strings.Repeat("x", n)}}, Padding: 11_000}
+	}
+
+	// This would use up most of the file's 8 KiB padding, so it's grown first, and the save fits in it
+	res, err := taglib.Apply(path, comment(4_000))
+	nilErr(t, err)
+	eq(t, res.Saved, true)
+	eq(t, res.InPlace, false)
+	eq(t, res.Shifts, 1)
+
+	// 5 KB more wouldn't have fit in what was left before
+	res, err = taglib.Apply(path, comment(9_000))
+	nilErr(t, err)
+	eq(t, res.Saved, true)
+	eq(t, res.InPlace, true)
+	eq(t, res.Shifts, 0)
+
+	tags, err := taglib.ReadTags(path)
+	nilErr(t, err)
+	eq(t, len(tags[taglib.Comment][0]), 9_000)
+
+	// The ID3v2 tag has about 1 KB, and padding is capped at TagLib's minimum for a file this small
+	path = tmpf(t, egMP3, "eg.mp3")
+	res, err = taglib.Apply(path, comment(2_000))
+	nilErr(t, err)
+	eq(t, res.Shifts, 1)
+
+	res, err = taglib.Apply(path, comment(2_300))
+	nilErr(t, err)
+	eq(t, res.Saved, true)
+	eq(t, res.Shifts, 0)
+}
+
 func TestWriteImage(t *testing.T) {
 	path := tmpf(t, egFLAC, "eg.flac")
-	coverpath := tmpf(t, coverJPG, "cover.jpg")
+	coverpath := tmpf(t, coverPNG, "cover.png")
 
 	err := taglib.ClearImages(path)
 	nilErr(t, err)
@@ -331,6 +809,292 @@ func TestClearImage(t *testing.T) {
 	}
 }
 
+func TestOpen(t *testing.T) {
+	t.Parallel()
+
+	path := tmpf(t, egFLAC, "eg.flac")
+
+	f, err := taglib.Open(path)
+	nilErr(t, err)
+	defer f.Close()
+
+	properties, err := f.Properties()
+	nilErr(t, err)
+	eq(t, 1*time.Second, properties.Length)
+
+	img, err := f.Image()
+	nilErr(t, err)
+	cfg, _, err := image.DecodeConfig(img)
+	nilErr(t, err)
+	eq(t, 700, cfg.Width)
+
+	tags := map[string][]string{
+		"ARTIST": {"Example A", "Example B"},
+		"ALBUM":  {"Example"},
+	}
+	nilErr(t, f.SetTags(tags, taglib.Clear))
+
+	got, err := f.Tags()
+	nilErr(t, err)
+	tagEq(t, got, tags)
+
+	nilErr(t, f.Save())
+	nilErr(t, f.Close())
+
+	got, err = taglib.ReadTags(path)
+	nilErr(t, err)
+	tagEq(t, got, tags)
+}
+
+func TestOpenMany(t *testing.T) {
+	t.Parallel()
+
+	// More open files than there are pooled instances mustn't hold up opening more, or other calls
+	var files []*taglib.File
+	for i := range 2*runtime.GOMAXPROCS(0) + 1 {
+		f, err := taglib.Open(tmpf(t, egMP3, fmt.Sprintf("%d.mp3", i)))
+		nilErr(t, err)
+		files = append(files, f)
+	}
+
+	path := tmpf(t, egFLAC, "eg.flac")
+	nilErr(t, taglib.WriteTags(path, map[string][]string{"ALBUM": {"Example"}}, 0))
+
+	for _, f := range files {
+		_, err := f.Tags()
+		nilErr(t, err)
+		nilErr(t, f.Close())
+	}
+}
+
+func TestOpenInvalid(t *testing.T) {
+	t.Parallel()
+
+	path := tmpf(t, []byte("not a file"), "eg.flac")
+	_, err := taglib.Open(path)
+	eq(t, err, taglib.ErrInvalidFile)
+}
+
+func TestReadAll(t *testing.T) {
+	t.Parallel()
+
+	path := tmpf(t, egFLAC, "eg.flac")
+	err := taglib.WriteTags(path, bigTags, taglib.Clear)
+	nilErr(t, err)
+
+	res, err := taglib.ReadAll(path)
+	nilErr(t, err)
+
+	tagEq(t, res.Tags, bigTags)
+	eq(t, 1*time.Second, res.Properties.Length)
+	eq(t, 48_000, res.Properties.SampleRate)
+
+	if len(res.Images) == 0 {
+		t.Fatalf("no images")
+	}
+	if res.Images[0].Size == 0 || res.Images[0].MIMEType == "" {
+		t.Fatalf("bad image info: %+v", res.Images[0])
+	}
+}
+
+func TestReadAllocs(t *testing.T) {
+	path := tmpf(t, egFLAC, "eg.flac")
+
+	allocs := func(tags map[string][]string) float64 {
+		err := taglib.WriteTags(path, tags, taglib.Clear)
+		nilErr(t, err)
+
+		return testing.AllocsPerRun(100, func() {
+			_, err := taglib.ReadTags(path)
+			nilErr(t, err)
+		})
+	}
+
+	small := allocs(map[string][]string{"TITLE": {"Title"}})
+	big := allocs(bigTags)
+	if big > small+2 {
+		t.Fatalf("allocs grow with tag count: %v for %d tags, %v for 1", big, len(bigTags), small)
+	}
+}
+
+func TestReadTagsBatch(t *testing.T) {
+	t.Parallel()
+
+	paths := testPaths(t)
+	for i, path := range paths {
+		err := taglib.WriteTags(path, map[string][]string{
+			"TITLE": {fmt.Sprintf("Title %d", i)},
+		}, taglib.Clear)
+		nilErr(t, err)
+	}
+
+	invalid := tmpf(t, []byte("not a file"), "eg.flac")
+	paths = slices.Insert(paths, 2, invalid)
+
+	results, err := taglib.ReadTagsBatch(paths)
+	nilErr(t, err)
+	eq(t, len(results), len(paths))
+
+	eq(t, results[2].Err, taglib.ErrInvalidFile)
+	results = slices.Delete(results, 2, 3)
+
+	for i, res := range results {
+		nilErr(t, res.Err)
+		tagEq(t, res.Tags, map[string][]string{
+			"TITLE": {fmt.Sprintf("Title %d", i)},
+		})
+	}
+}
+
+func TestScan(t *testing.T) {
+	t.Parallel()
+
+	dir := t.TempDir()
+	write := func(name string, b []byte) string {
+		path := filepath.Join(dir, name)
+		nilErr(t, os.MkdirAll(filepath.Dir(path), os.ModePerm))
+		nilErr(t, os.WriteFile(path, b, os.ModePerm))
+		return path
+	}
+
+	want := []string{
+		write("a/eg.flac", egFLAC),
+		write("a/eg.mp3", egMP3),
+		write("b/c/eg.m4a", egM4a),
+		write("eg.ogg", egOgg),
+	}
+	write("a/cover.png", coverPNG)
+	invalid := write("b/invalid.flac", []byte("not a file"))
+
+	var got []string
+	for res := range taglib.Scan(context.Background(), dir, taglib.ScanOptions{Workers: 2, Fields: taglib.FieldTags | taglib.FieldProperties}) {
+		if res.Path == invalid {
+			eq(t, res.Err, taglib.ErrInvalidFile)
+			continue
+		}
+		nilErr(t, res.Err)
+		if res.Tags == nil || res.Properties.SampleRate == 0 {
+			t.Fatalf("missing fields for %s: %+v", res.Path, res.Result)
+		}
+		got = append(got, res.Path)
+	}
+
+	slices.Sort(got)
+	slices.Sort(want)
+	if !slices.Equal(got, want) {
+		t.Fatalf("%q != %q", got, want)
+	}
+}
+
+func TestScanConsumerReads(t *testing.T) {
+	t.Parallel()
+
+	dir := t.TempDir()
+	for i := range 4 * runtime.GOMAXPROCS(0) {
+		nilErr(t, os.WriteFile(filepath.Join(dir, fmt.Sprintf("%d.flac", i)), egFLAC, os.ModePerm))
+	}
+
+	// With every worker busy, reading each result's file from the consumer must still get an instance
+	for res := range taglib.Scan(context.Background(), dir, taglib.ScanOptions{}) {
+		nilErr(t, res.Err)
+		_, err := taglib.ImageSize(res.Path)
+		nilErr(t, err)
+	}
+}
+
+func TestReadBytes(t *testing.T) {
+	t.Parallel()
+
+	path := tmpf(t, egFLAC, "eg.flac")
+	err := taglib.WriteTags(path, bigTags, taglib.Clear)
+	nilErr(t, err)
+
+	b, err := os.ReadFile(path)
+	nilErr(t, err)
+
+	tags, err := taglib.ReadTagsBytes(b)
+	nilErr(t, err)
+	tagEq(t, tags, bigTags)
+
+	properties, err := taglib.ReadPropertiesBytes(b)
+	nilErr(t, err)
+	eq(t, 1*time.Second, properties.Length)
+
+	img, err := taglib.ReadImageBytes(b)
+	nilErr(t, err)
+	cfg, _, err := image.DecodeConfig(img)
+	nilErr(t, err)
+	eq(t, 700, cfg.Width)
+
+	_, err = taglib.ReadTagsBytes([]byte("not a file"))
+	eq(t, err, taglib.ErrInvalidFile)
+}
+
+func TestReadWriteStream(t *testing.T) {
+	t.Parallel()
+
+	for _, path := range testPaths(t) {
+		t.Run(filepath.Base(path), func(t *testing.T) {
+			f, err := os.OpenFile(path, os.O_RDWR, 0)
+			nilErr(t, err)
+			defer f.Close()
+
+			// big enough to move the audio, then small again so the file shrinks
+			for _, tags := range []map[string][]string{bigTags, {"TITLE": {"Title"}}} {
+				err = taglib.WriteTagsTo(f, tags, taglib.Clear)
+				nilErr(t, err)
+
+				got, err := taglib.ReadTagsFrom(f)
+				nilErr(t, err)
+				tagEq(t, got, tags)
+
+				got, err = taglib.ReadTags(path)
+				nilErr(t, err)
+				tagEq(t, got, tags)
+			}
+		})
+	}
+}
+
+func TestReadStreamInvalid(t *testing.T) {
+	t.Parallel()
+
+	_, err := taglib.ReadTagsFrom(strings.NewReader("not a file"))
+	eq(t, err, taglib.ErrInvalidFile)
+}
+
+func TestCachedReader(t *testing.T) {
+	t.Parallel()
+
+	for _, path := range testPaths(t) {
+		t.Run(filepath.Base(path), func(t *testing.T) {
+			b, err := os.ReadFile(path)
+			nilErr(t, err)
+
+			want, err := taglib.ReadTags(path)
+			nilErr(t, err)
+
+			r := taglib.NewCachedReader(bytes.NewReader(b), int64(len(b)), taglib.CacheHint(path))
+			got, err := taglib.ReadTagsFrom(r)
+			nilErr(t, err)
+			tagEq(t, got, want)
+
+			stats := r.Stats()
+			if stats.Hits == 0 {
+				t.Errorf("no cache hits: %+v", stats)
+			}
+			// eg.flac has a picture bigger than the head, so it takes one more request
+			if limit := 2; stats.Requests > limit && filepath.Ext(path) != ".flac" {
+				t.Errorf("%d requests, want at most %d", stats.Requests, limit)
+			}
+
+			if _, err := r.ReadAt(make([]byte, 4), -1); err == nil {
+				t.Errorf("expected error for negative offset")
+			}
+		})
+	}
+}
+
 func TestMemNew(t *testing.T) {
 	t.Parallel()
 
@@ -388,6 +1152,25 @@ func BenchmarkRead(b *testing.B) {
 	}
 }
 
+func BenchmarkReadFormats(b *testing.B) {
+	for _, path := range testPaths(b) {
+		b.Run(filepath.Base(path), func(b *testing.B) {
+			// The same tag read with and without audio properties, which is what tag-only reads now skip.
+			// Scan is the public API that can do both with one guest call
+			dir := filepath.Dir(path)
+			read := func(b *testing.B, fields taglib.Field) {
+				for range b.N {
+					for res := range taglib.Scan(context.Background(), dir, taglib.ScanOptions{Workers: 1, Fields: fields}) {
+						nilErr(b, res.Err)
+					}
+				}
+			}
+			b.Run("tags", func(b *testing.B) { read(b, taglib.FieldTags) })
+			b.Run("tags+properties", func(b *testing.B) { read(b, taglib.FieldTags|taglib.FieldProperties) })
+		})
+	}
+}
+
 var (
 	//go:embed testdata/eg.flac
 	egFLAC []byte
@@ -399,8 +1182,18 @@ var (
 	egOgg []byte
 	//go:embed testdata/eg.wav
 	egWAV []byte
-	//go:embed testdata/cover.jpg
-	coverJPG []byte
+	//go:embed testdata/cover.png
+	coverPNG []byte
+	//go:embed testdata/image.jpg
+	imageJPEG []byte
+	//go:embed testdata/image.gif
+	imageGIF []byte
+	//go:embed testdata/image-vp8.webp
+	imageVP8 []byte
+	//go:embed testdata/image-vp8l.webp
+	imageVP8L []byte
+	//go:embed testdata/image-vp8x.webp
+	imageVP8X []byte
 )
 
 func testPaths(t testing.TB) []string {